@@ -0,0 +1,127 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Times gpx_strtod and gpx_decode_time against strtod and strptime on
+// fields like those in a GPX track, and checks they give the same values
+//
+// usage: bench_decode [count]
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gpx_decode.h"
+
+#define DEFAULT_COUNT (1000000)
+#define FIELD_SIZE (32)
+
+double seconds_since(const struct timespec *start);
+void make_fields(char (*coords)[FIELD_SIZE], char (*times)[FIELD_SIZE], int count);
+void report(const char *name, double seconds, int count);
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+    if (count <= 0) {
+        fprintf(stderr, "USAGE: %s [count]\n", argv[0]);
+        return 1;
+    }
+
+    char (*coords)[FIELD_SIZE] = malloc(sizeof(*coords) * count);
+    char (*times)[FIELD_SIZE] = malloc(sizeof(*times) * count);
+    double *values = malloc(sizeof(*values) * count);
+    long *epoch_times = malloc(sizeof(*epoch_times) * count);
+    if (coords == NULL || times == NULL || values == NULL || epoch_times == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    make_fields(coords, times, count);
+
+    struct timespec start;
+    int mismatches = 0;
+
+    // coordinates
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) values[i] = strtod(coords[i], NULL);
+    report("strtod", seconds_since(&start), count);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) {
+        double value = gpx_strtod(coords[i], NULL);
+        mismatches += value != values[i];
+    }
+    report("gpx_strtod", seconds_since(&start), count);
+
+    // timestamps
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        strptime(times[i], "%Y-%m-%dT%H:%M:%SZ", &tm);
+        epoch_times[i] = timegm(&tm);
+    }
+    report("strptime+timegm", seconds_since(&start), count);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) {
+        long time;
+        gpx_parse_time(times[i], &time);
+        mismatches += time != epoch_times[i];
+    }
+    report("gpx_parse_time", seconds_since(&start), count);
+
+    gpx_date_cache cache = {{0}};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) {
+        long time;
+        gpx_decode_time(times[i], &cache, &time);
+        mismatches += time != epoch_times[i];
+    }
+    report("gpx_decode_time", seconds_since(&start), count);
+
+    if (mismatches) printf("%d values differ\n", mismatches);
+
+    free(coords);
+    free(times);
+    free(values);
+    free(epoch_times);
+    return mismatches != 0;
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: returns the seconds elapsed since start
+double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// post: fills coords with 7-decimal lat/lon text and times with one
+// timestamp per second of a track starting at 2022-10-01T00:00:00Z
+void make_fields(char (*coords)[FIELD_SIZE], char (*times)[FIELD_SIZE], int count) {
+    srand(223);
+    time_t t = 1664582400;
+    for (int i = 0; i < count; i++) {
+        double coord = (rand() / (double) RAND_MAX) * 360.0 - 180.0;
+        snprintf(coords[i], FIELD_SIZE, "%.7f", coord);
+
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(times[i], FIELD_SIZE, "%Y-%m-%dT%H:%M:%SZ", &tm);
+        t++;
+    }
+}
+
+// post: prints the time per field for the given run
+void report(const char *name, double seconds, int count) {
+    printf("%-16s %6.1f ns/field\n", name, seconds * 1e9 / count);
+}
@@ -0,0 +1,296 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Generates synthetic GPX files in several styles and times parse_GPX
+// on each, reporting MB/s, points/s and peak memory
+//
+// usage: bench_parse [-mb size] [-runs n] [-parser path] [-keep dir] [-- parser options]
+// -mb is the size of each generated file (64 by default); -runs is how
+// many times each is parsed (3 by default), of which the fastest counts.
+// -parser is the program to time (./ParseGPX by default), and anything
+// after -- is passed to it before the file name, e.g. "-- -threads 4".
+// The files go in a temporary directory that is removed afterwards, or
+// in the -keep directory (made if need be), where they are left
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DEFAULT_MB (64)
+#define DEFAULT_RUNS (3)
+#define DEFAULT_PARSER "./ParseGPX"
+#define MAX_PARSER_ARGS (32)
+#define PATH_SIZE (4096)
+
+// how a generated file is written
+typedef struct {
+    const char *name;
+    int pretty;                 // 1 for one element per indented line
+    int lon_first;              // 1 to write lon before lat
+    char quote;                 // quote around attribute values
+    int extensions;             // 1 to give every trkpt an extensions block
+    int points_per_segment;
+} gpx_style;
+
+static const gpx_style styles[] = {
+    {"pretty",        1, 0, '"',  0, 1000},
+    {"minified",      0, 0, '"',  0, 1000},
+    {"lon-first",     1, 1, '"',  0, 1000},
+    {"single-quoted", 1, 0, '\'', 0, 1000},
+    {"extensions",    1, 0, '"',  1, 1000},
+    {"small-segments", 1, 0, '"', 0, 10},
+    {"one-segment",   1, 0, '"',  0, 0}
+};
+
+#define NUM_STYLES ((int) (sizeof(styles) / sizeof(styles[0])))
+
+long write_gpx(const char *path, const gpx_style *style, size_t size);
+void write_trkpt(FILE *out, const gpx_style *style, double lat, double lon, double ele, time_t t);
+int time_parser(char **parser_argv, int file_arg, double *seconds, long *max_rss_kb);
+double seconds_since(const struct timespec *start);
+
+int main(int argc, char **argv)
+{
+    int mb = DEFAULT_MB;
+    int runs = DEFAULT_RUNS;
+    const char *parser = DEFAULT_PARSER;
+    const char *keep_dir = NULL;
+    int usage_error = 0;
+    int arg = 1;
+
+    while (arg < argc && !usage_error) {
+        if (arg + 1 < argc && strcmp(argv[arg], "-mb") == 0) {
+            mb = atoi(argv[arg + 1]);
+            usage_error = mb <= 0;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-runs") == 0) {
+            runs = atoi(argv[arg + 1]);
+            usage_error = runs <= 0;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-parser") == 0) {
+            parser = argv[arg + 1];
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-keep") == 0) {
+            keep_dir = argv[arg + 1];
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--") == 0) {
+            arg++;
+            break;
+        }
+        else usage_error = 1;
+    }
+
+    // the parser, its options, the file, and a NULL
+    int num_options = argc - arg;
+    if (usage_error || num_options > MAX_PARSER_ARGS - 3) {
+        fprintf(stderr, "USAGE: %s [-mb size] [-runs n] [-parser path] [-keep dir] [-- parser options]\n", argv[0]);
+        return 1;
+    }
+
+    char dir[PATH_SIZE];
+    if (keep_dir != NULL) {
+        snprintf(dir, sizeof(dir), "%s", keep_dir);
+        if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+            perror(dir);
+            return 1;
+        }
+    }
+    else {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(dir, sizeof(dir), "%s/bench_parse.XXXXXX", tmp != NULL ? tmp : "/tmp");
+        if (mkdtemp(dir) == NULL) {
+            perror(dir);
+            return 1;
+        }
+    }
+
+    char path[2 * PATH_SIZE];
+    char *parser_argv[MAX_PARSER_ARGS];
+    parser_argv[0] = (char *) parser;
+    for (int i = 0; i < num_options; i++) parser_argv[i + 1] = argv[arg + i];
+    int file_arg = num_options + 1;
+    parser_argv[file_arg] = path;
+    parser_argv[file_arg + 1] = NULL;
+
+    printf("%-15s %8s %10s %8s %8s %10s %8s\n", "style", "MB", "points", "seconds", "MB/s", "Mpoints/s", "RSS MB");
+
+    int failed = 0;
+    for (int i = 0; i < NUM_STYLES && !failed; i++) {
+        snprintf(path, sizeof(path), "%s/%s.gpx", dir, styles[i].name);
+        long num_points = write_gpx(path, &styles[i], (size_t) mb << 20);
+        if (num_points < 0) {
+            failed = 1;
+            break;
+        }
+
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            perror(path);
+            failed = 1;
+            break;
+        }
+        double file_mb = st.st_size / (double) (1 << 20);
+
+        // the first run also brings the file into the page cache
+        double best = 0.0;
+        long max_rss_kb = 0;
+        for (int run = 0; run < runs && !failed; run++) {
+            double seconds;
+            long rss_kb;
+            failed = time_parser(parser_argv, file_arg, &seconds, &rss_kb);
+            if (run == 0 || seconds < best) best = seconds;
+            if (rss_kb > max_rss_kb) max_rss_kb = rss_kb;
+        }
+
+        if (!failed) {
+            printf("%-15s %8.1f %10ld %8.3f %8.1f %10.2f %8.1f\n", styles[i].name, file_mb, num_points,
+                   best, file_mb / best, num_points / best / 1e6, max_rss_kb / 1024.0);
+            fflush(stdout);
+        }
+        if (keep_dir == NULL) remove(path);
+    }
+
+    if (keep_dir == NULL) rmdir(dir);
+    return failed;
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: writes a GPX file of about size bytes in the given style to
+// path: one track of 1 Hz points wandering around New Haven
+// returns the number of trkpts written, or -1 if the file can't be written
+long write_gpx(const char *path, const gpx_style *style, size_t size) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    const char *nl = style->pretty ? "\n" : "";
+    fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>%s", nl);
+    fprintf(out, "<gpx version=\"1.1\" creator=\"bench_parse\" xmlns=\"http://www.topografix.com/GPX/1/1\"");
+    if (style->extensions) {
+        fprintf(out, " xmlns:gpxtpx=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v1\"");
+    }
+    fprintf(out, ">%s%s<trk>%s%s<name>bench %s</name>%s",
+            nl, style->pretty ? " " : "", nl, style->pretty ? "  " : "", style->name, nl);
+
+    srand(223);
+    double lat = 41.3078680;
+    double lon = -72.9342120;
+    double ele = 20.0;
+    time_t t = 1664582400;
+    long num_points = 0;
+
+    while ((size_t) ftell(out) < size) {
+        fprintf(out, "%s<trkseg>%s", style->pretty ? "  " : "", nl);
+        for (int i = 0; style->points_per_segment == 0 || i < style->points_per_segment; i++) {
+            lat += (rand() / (double) RAND_MAX - 0.5) * 1e-4;
+            lon += (rand() / (double) RAND_MAX - 0.5) * 1e-4;
+            ele += (rand() / (double) RAND_MAX - 0.5);
+            write_trkpt(out, style, lat, lon, ele, t++);
+            num_points++;
+
+            if (num_points % 1024 == 0 && (size_t) ftell(out) >= size) break;
+        }
+        fprintf(out, "%s</trkseg>%s", style->pretty ? "  " : "", nl);
+    }
+
+    fprintf(out, "%s</trk>%s</gpx>%s", style->pretty ? " " : "", nl, nl);
+    if (fclose(out) != 0) {
+        perror(path);
+        return -1;
+    }
+    return num_points;
+}
+
+// post: writes one trkpt element in the given style
+void write_trkpt(FILE *out, const gpx_style *style, double lat, double lon, double ele, time_t t) {
+    const char *indent = style->pretty ? "   " : "";
+    const char *inner = style->pretty ? "\n    " : "";
+    char q = style->quote;
+
+    struct tm tm;
+    char time_text[32];
+    gmtime_r(&t, &tm);
+    strftime(time_text, sizeof(time_text), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    if (style->lon_first) {
+        fprintf(out, "%s<trkpt lon=%c%.7f%c lat=%c%.7f%c>", indent, q, lon, q, q, lat, q);
+    }
+    else {
+        fprintf(out, "%s<trkpt lat=%c%.7f%c lon=%c%.7f%c>", indent, q, lat, q, q, lon, q);
+    }
+    fprintf(out, "%s<ele>%.1f</ele>%s<time>%s</time>", inner, ele, inner, time_text);
+
+    if (style->extensions) {
+        fprintf(out, "%s<extensions><gpxtpx:TrackPointExtension><gpxtpx:atemp>21.5</gpxtpx:atemp>"
+                "<gpxtpx:hr>%d</gpxtpx:hr><gpxtpx:cad>%d</gpxtpx:cad></gpxtpx:TrackPointExtension>"
+                "<power>%d</power><note>lap &lt;%ld&gt;</note></extensions>",
+                inner, 120 + (int) (t % 40), 80 + (int) (t % 15), 200 + (int) (t % 90), (long) t);
+    }
+    fprintf(out, "%s</trkpt>%s", style->pretty ? "\n   " : "", style->pretty ? "\n" : "");
+}
+
+// post: runs the parser on parser_argv[file_arg] with its output thrown
+// away, and sets *seconds to the time it took and *max_rss_kb to its
+// peak resident memory
+// returns 0 on success, 1 if it couldn't be run or failed
+int time_parser(char **parser_argv, int file_arg, double *seconds, long *max_rss_kb) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+        execv(parser_argv[0], parser_argv);
+        perror(parser_argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        return 1;
+    }
+    *seconds = seconds_since(&start);
+    *max_rss_kb = usage.ru_maxrss;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed on %s\n", parser_argv[0], parser_argv[file_arg]);
+        return 1;
+    }
+    return 0;
+}
+
+// post: returns the seconds elapsed since start
+double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,258 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Writes and maps binary columnar point files
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gpx_columns.h"
+
+#define NUM_SPILLED_COLUMNS (4)
+#define LAT_COLUMN (0)
+#define LON_COLUMN (1)
+#define ELE_COLUMN (2)
+#define TIME_COLUMN (3)
+
+#define SPILL_BUFFER_SIZE (1 << 16)
+#define COPY_BUFFER_SIZE (1 << 16)
+#define INITIAL_SEGMENTS (16)
+
+struct gpx_columns_writer {
+    FILE *out;
+    uint32_t flags;
+    FILE *columns[NUM_SPILLED_COLUMNS];     // temporary files
+    uint64_t num_points;
+    uint64_t *segments;                     // first point of each segment
+    uint64_t num_segments;
+    uint64_t segments_capacity;
+    int in_segment;                         // 0 until a point is added
+    int failed;
+};
+
+static void destroy_writer(gpx_columns_writer *w);
+static uint64_t align8(uint64_t n);
+static int copy_column(FILE *from, FILE *to, uint64_t length);
+static int write_padding(FILE *to, uint64_t length);
+
+
+gpx_columns_writer *gpx_columns_create(FILE *out, uint32_t flags) {
+    gpx_columns_writer *w = calloc(1, sizeof(*w));
+    if (w == NULL) return NULL;
+
+    w->out = out;
+    w->flags = flags;
+
+    w->segments_capacity = INITIAL_SEGMENTS;
+    w->segments = malloc(sizeof(*w->segments) * w->segments_capacity);
+    if (w->segments == NULL) {
+        free(w);
+        return NULL;
+    }
+
+    for (int i = 0; i < NUM_SPILLED_COLUMNS; i++) {
+        w->columns[i] = tmpfile();
+        if (w->columns[i] == NULL) {
+            destroy_writer(w);
+            return NULL;
+        }
+        setvbuf(w->columns[i], NULL, _IOFBF, SPILL_BUFFER_SIZE);
+    }
+
+    return w;
+}
+
+void gpx_columns_start_segment(gpx_columns_writer *w) {
+    w->in_segment = 0;
+}
+
+void gpx_columns_add_point(gpx_columns_writer *w, double lat, double lon, float ele, int64_t time) {
+    if (!w->in_segment) {
+        if (w->num_segments == w->segments_capacity) {
+            uint64_t *bigger = realloc(w->segments, sizeof(*bigger) * w->segments_capacity * 2);
+            if (bigger == NULL) {
+                w->failed = 1;
+                return;
+            }
+            w->segments = bigger;
+            w->segments_capacity *= 2;
+        }
+        w->segments[w->num_segments++] = w->num_points;
+        w->in_segment = 1;
+    }
+
+    if (w->flags & GPX_COLUMNS_E6) {
+        int32_t lat_e6 = lround(lat * 1e6);
+        int32_t lon_e6 = lround(lon * 1e6);
+        fwrite(&lat_e6, sizeof(lat_e6), 1, w->columns[LAT_COLUMN]);
+        fwrite(&lon_e6, sizeof(lon_e6), 1, w->columns[LON_COLUMN]);
+    }
+    else {
+        fwrite(&lat, sizeof(lat), 1, w->columns[LAT_COLUMN]);
+        fwrite(&lon, sizeof(lon), 1, w->columns[LON_COLUMN]);
+    }
+    fwrite(&ele, sizeof(ele), 1, w->columns[ELE_COLUMN]);
+    fwrite(&time, sizeof(time), 1, w->columns[TIME_COLUMN]);
+
+    w->num_points++;
+}
+
+int gpx_columns_finish(gpx_columns_writer *w) {
+    uint64_t n = w->num_points;
+    uint64_t lat_size = w->flags & GPX_COLUMNS_E6 ? sizeof(int32_t) : sizeof(double);
+
+    gpx_columns_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, GPX_COLUMNS_MAGIC);
+    header.version = GPX_COLUMNS_VERSION;
+    header.flags = w->flags;
+    header.num_points = n;
+    header.num_segments = w->num_segments;
+    header.lat_offset = align8(sizeof(header));
+    header.lon_offset = align8(header.lat_offset + n * lat_size);
+    header.ele_offset = align8(header.lon_offset + n * lat_size);
+    header.time_offset = align8(header.ele_offset + n * sizeof(float));
+    header.segments_offset = header.time_offset + n * sizeof(int64_t);
+
+    uint64_t sizes[NUM_SPILLED_COLUMNS] = {n * lat_size, n * lat_size, n * sizeof(float), n * sizeof(int64_t)};
+    uint64_t offsets[NUM_SPILLED_COLUMNS + 1] = {header.lat_offset, header.lon_offset,
+                                                 header.ele_offset, header.time_offset,
+                                                 header.segments_offset};
+
+    int failed = w->failed || fwrite(&header, sizeof(header), 1, w->out) != 1;
+    uint64_t written = sizeof(header);
+
+    for (int i = 0; i < NUM_SPILLED_COLUMNS && !failed; i++) {
+        failed = write_padding(w->out, offsets[i] - written)
+                 || copy_column(w->columns[i], w->out, sizes[i]);
+        written = offsets[i] + sizes[i];
+    }
+
+    if (!failed && w->num_segments > 0) {
+        failed = fwrite(w->segments, sizeof(*w->segments), w->num_segments, w->out) != w->num_segments;
+    }
+
+    failed = fflush(w->out) != 0 || failed;
+
+    destroy_writer(w);
+    return failed;
+}
+
+gpx_columns *gpx_columns_map(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(gpx_columns_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    const gpx_columns_header *header = data;
+    uint64_t n = header->num_points;
+    uint64_t lat_size = header->flags & GPX_COLUMNS_E6 ? sizeof(int32_t) : sizeof(double);
+
+    // check the file is what the header says it is before trusting it
+    if (memcmp(header->magic, GPX_COLUMNS_MAGIC, sizeof(GPX_COLUMNS_MAGIC)) != 0
+        || header->version != GPX_COLUMNS_VERSION
+        || n > (uint64_t) info.st_size
+        || header->num_segments > (uint64_t) info.st_size
+        || header->lat_offset < sizeof(*header)
+        || header->lat_offset + n * lat_size > header->lon_offset
+        || header->lon_offset + n * lat_size > header->ele_offset
+        || header->ele_offset + n * sizeof(float) > header->time_offset
+        || header->time_offset + n * sizeof(int64_t) > header->segments_offset
+        || header->segments_offset + header->num_segments * sizeof(uint64_t) > (uint64_t) info.st_size) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+
+    gpx_columns *cols = calloc(1, sizeof(*cols));
+    if (cols == NULL) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+
+    const char *bytes = data;
+    cols->header = header;
+    cols->num_points = n;
+    cols->num_segments = header->num_segments;
+    if (header->flags & GPX_COLUMNS_E6) {
+        cols->lat_e6 = (const int32_t *) (bytes + header->lat_offset);
+        cols->lon_e6 = (const int32_t *) (bytes + header->lon_offset);
+    }
+    else {
+        cols->lat = (const double *) (bytes + header->lat_offset);
+        cols->lon = (const double *) (bytes + header->lon_offset);
+    }
+    cols->ele = (const float *) (bytes + header->ele_offset);
+    cols->time = (const int64_t *) (bytes + header->time_offset);
+    cols->segments = (const uint64_t *) (bytes + header->segments_offset);
+    cols->mapped_length = info.st_size;
+
+    return cols;
+}
+
+void gpx_columns_unmap(gpx_columns *cols) {
+    if (cols == NULL) return;
+
+    munmap((void *) cols->header, cols->mapped_length);
+    free(cols);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: closes the writer's temporary files and frees it
+static void destroy_writer(gpx_columns_writer *w) {
+    for (int i = 0; i < NUM_SPILLED_COLUMNS; i++) {
+        if (w->columns[i] != NULL) fclose(w->columns[i]);
+    }
+    free(w->segments);
+    free(w);
+}
+
+// post: returns n rounded up to a multiple of 8
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+// post: copies the first length bytes of the temporary file to the stream
+// returns 0 on success, 1 on failure
+static int copy_column(FILE *from, FILE *to, uint64_t length) {
+    char buffer[COPY_BUFFER_SIZE];
+
+    if (fflush(from) != 0 || fseek(from, 0, SEEK_SET) != 0) return 1;
+
+    while (length > 0) {
+        size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+        if (fread(buffer, 1, chunk, from) != chunk) return 1;
+        if (fwrite(buffer, 1, chunk, to) != chunk) return 1;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+// post: writes length (less than 8) zero bytes to the stream
+// returns 0 on success, 1 on failure
+static int write_padding(FILE *to, uint64_t length) {
+    static const char zeros[8] = {0};
+    return fwrite(zeros, 1, length, to) != length;
+}
@@ -0,0 +1,121 @@
+#ifndef __GPX_COLUMNS_H__
+#define __GPX_COLUMNS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Binary columnar point files.
+//
+// The file is a gpx_columns_header followed by one array per field,
+// each starting at the offset given in the header (a multiple of 8):
+//
+//   lat, lon   double degrees, or int32_t microdegrees if the
+//              GPX_COLUMNS_E6 flag is set
+//   ele        float meters, NaN if the point had no elevation
+//   time       int64_t seconds since 1970-01-01T00:00:00Z,
+//              GPX_COLUMNS_NO_TIME if the point had no time
+//   segments   uint64_t index of the first point of each segment
+//
+// Numbers are in the byte order of the machine that wrote the file, so
+// a reader can mmap the file and use the arrays in place.
+
+#define GPX_COLUMNS_MAGIC "GPXCOL1"
+#define GPX_COLUMNS_VERSION (1)
+
+// flags
+#define GPX_COLUMNS_E6 (1)
+
+#define GPX_COLUMNS_NO_TIME INT64_MIN
+
+typedef struct {
+    char magic[8];              // GPX_COLUMNS_MAGIC, '\0' terminated
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_points;
+    uint64_t num_segments;
+    uint64_t lat_offset;
+    uint64_t lon_offset;
+    uint64_t ele_offset;
+    uint64_t time_offset;
+    uint64_t segments_offset;
+} gpx_columns_header;
+
+typedef struct gpx_columns_writer gpx_columns_writer;
+
+// a columnar file mapped into memory; exactly one of lat/lat_e6 (and
+// lon/lon_e6) is non-NULL
+typedef struct {
+    const gpx_columns_header *header;
+    size_t num_points;
+    size_t num_segments;
+    const double *lat;
+    const double *lon;
+    const int32_t *lat_e6;
+    const int32_t *lon_e6;
+    const float *ele;
+    const int64_t *time;
+    const uint64_t *segments;
+    size_t mapped_length;
+} gpx_columns;
+
+
+/**
+ * Creates a writer that will write a columnar file to the given stream
+ * when finished.  Columns are kept in temporary files until then, so
+ * memory use doesn't grow with the number of points.
+ *
+ * @param out a stream open for writing; need not be seekable
+ * @param flags 0 or GPX_COLUMNS_E6
+ * @return a pointer to the new writer, or NULL on failure
+ */
+gpx_columns_writer *gpx_columns_create(FILE *out, uint32_t flags);
+
+
+/**
+ * Starts a new segment.  Points added before the first call are in a
+ * segment of their own; segments without points are not recorded.
+ *
+ * @param w a pointer to a writer, non-NULL
+ */
+void gpx_columns_start_segment(gpx_columns_writer *w);
+
+
+/**
+ * Adds a point to the current segment.
+ *
+ * @param w a pointer to a writer, non-NULL
+ * @param lat latitude in degrees
+ * @param lon longitude in degrees
+ * @param ele elevation in meters, or NaN
+ * @param time seconds since the epoch, or GPX_COLUMNS_NO_TIME
+ */
+void gpx_columns_add_point(gpx_columns_writer *w, double lat, double lon, float ele, int64_t time);
+
+
+/**
+ * Writes the file and destroys the writer.
+ *
+ * @param w a pointer to a writer, non-NULL
+ * @return 0 on success, 1 if writing failed
+ */
+int gpx_columns_finish(gpx_columns_writer *w);
+
+
+/**
+ * Maps the given columnar file into memory.
+ *
+ * @param path the name of a file written by a gpx_columns_writer
+ * @return a pointer to the mapped columns, or NULL if the file can't be
+ * opened or isn't a columnar file
+ */
+gpx_columns *gpx_columns_map(const char *path);
+
+
+/**
+ * Unmaps the given columns.
+ *
+ * @param cols a pointer returned by gpx_columns_map, or NULL
+ */
+void gpx_columns_unmap(gpx_columns *cols);
+
+#endif
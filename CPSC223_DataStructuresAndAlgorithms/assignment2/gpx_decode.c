@@ -0,0 +1,205 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Fast decoding of GPX coordinates, elevations and timestamps
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "gpx_decode.h"
+
+// most significant digits that always fit in a uint64_t
+#define MAX_DIGITS (19)
+
+// 10^22 is the largest power of ten a double holds exactly
+#define MAX_EXACT_POWER (22)
+
+// mantissas up to 2^53 are exact doubles
+#define MAX_EXACT_MANTISSA ((uint64_t) 1 << 53)
+
+static const double exact_powers[MAX_EXACT_POWER + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline int digit_value(char c);
+static long days_from_civil(long year, int month, int day);
+static int parse_digits(const char **text, int n, int *value);
+static int parse_date(const char *text, long *days);
+
+
+double gpx_strtod(const char *text, char **end) {
+    const char *p = text;
+    while (isspace((unsigned char) *p)) p++;
+
+    int negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+
+    // leave inf, nan, hex and non-numbers to the library
+    if (digit_value(*p) < 0 && !(*p == '.' && digit_value(p[1]) >= 0)) return strtod(text, end);
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) return strtod(text, end);
+
+    uint64_t mantissa = 0;
+    int digits = 0;         // significant digits in mantissa
+    int exponent = 0;       // value is mantissa * 10^exponent
+    int d;
+
+    for (; (d = digit_value(*p)) >= 0; p++) {
+        if (mantissa == 0 && d == 0) continue;
+        mantissa = mantissa * 10 + d;
+        digits++;
+        if (digits > MAX_DIGITS) return strtod(text, end);
+    }
+    if (*p == '.') {
+        for (p++; (d = digit_value(*p)) >= 0; p++) {
+            exponent--;
+            if (mantissa == 0 && d == 0) continue;
+            mantissa = mantissa * 10 + d;
+            digits++;
+            if (digits > MAX_DIGITS) return strtod(text, end);
+        }
+    }
+
+    // the exponent only counts if it has digits
+    if (*p == 'e' || *p == 'E') {
+        const char *q = p + 1;
+        int exponent_negative = *q == '-';
+        if (*q == '-' || *q == '+') q++;
+        if (digit_value(*q) >= 0) {
+            int written = 0;
+            for (; (d = digit_value(*q)) >= 0; q++) {
+                written = written * 10 + d;
+                if (written > 9999) return strtod(text, end);
+            }
+            exponent += exponent_negative ? -written : written;
+            p = q;
+        }
+    }
+
+    if (end != NULL) *end = (char *) p;
+
+    // with both the mantissa and 10^|exponent| exact, one multiply or
+    // divide rounds correctly (Clinger's fast path); anything else goes
+    // to strtod
+    double value;
+    if (mantissa == 0) value = 0.0;
+    else if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER) {
+        value = (double) mantissa;
+        if (exponent < 0) value /= exact_powers[-exponent];
+        else value *= exact_powers[exponent];
+    }
+    else return strtod(text, end);
+
+    return negative ? -value : value;
+}
+
+int gpx_decode_time(const char *text, gpx_date_cache *cache, long *time) {
+    int hour, minute, second;
+
+    while (isspace((unsigned char) *text)) text++;
+
+    // YYYY-MM-DD, usually the same as last time
+    long days;
+    if (cache != NULL && cache->date[0] != '\0'
+        && strncmp(text, cache->date, GPX_DATE_LENGTH) == 0) days = cache->days;
+    else {
+        if (parse_date(text, &days)) return 1;
+        if (cache != NULL) {
+            memcpy(cache->date, text, GPX_DATE_LENGTH);
+            cache->days = days;
+        }
+    }
+    text += GPX_DATE_LENGTH;
+
+    // THH:MM:SS
+    if (*text != 'T' && *text != 't' && *text != ' ') return 1;
+    text++;
+    if (parse_digits(&text, 2, &hour) || *text++ != ':') return 1;
+    if (parse_digits(&text, 2, &minute) || *text++ != ':') return 1;
+    if (parse_digits(&text, 2, &second)) return 1;
+
+    if (hour > 23 || minute > 59 || second > 60) return 1;
+
+    // fractional seconds are dropped
+    if (*text == '.') {
+        text++;
+        while (digit_value(*text) >= 0) text++;
+    }
+
+    // Z, nothing (taken as UTC), or an offset from UTC
+    long offset = 0;
+    if (*text == 'Z' || *text == 'z') text++;
+    else if (*text == '+' || *text == '-') {
+        int sign = *text++ == '-' ? -1 : 1;
+        int offset_hours, offset_minutes = 0;
+        if (parse_digits(&text, 2, &offset_hours)) return 1;
+        if (*text == ':') text++;
+        if (digit_value(*text) >= 0 && parse_digits(&text, 2, &offset_minutes)) return 1;
+        offset = sign * (offset_hours * 3600L + offset_minutes * 60L);
+    }
+
+    while (isspace((unsigned char) *text)) text++;
+    if (*text != '\0') return 1;
+
+    *time = days * 86400L + hour * 3600L + minute * 60L + second - offset;
+    return 0;
+}
+
+int gpx_parse_time(const char *text, long *time) {
+    return gpx_decode_time(text, NULL, time);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: returns the value of the given decimal digit, -1 if c isn't one
+static inline int digit_value(char c) {
+    unsigned d = (unsigned char) c - '0';
+    return d <= 9 ? (int) d : -1;
+}
+
+// post: returns the number of days from 1970-01-01 to the given date in
+// the proleptic Gregorian calendar (Howard Hinnant's algorithm)
+static long days_from_civil(long year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long year_of_era = year - era * 400;
+    long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// post: reads exactly n decimal digits from *text into *value, advancing
+// *text past them
+// returns 0 on success, 1 if there aren't n digits
+static int parse_digits(const char **text, int n, int *value) {
+    *value = 0;
+    for (int i = 0; i < n; i++) {
+        int d = digit_value((*text)[i]);
+        if (d < 0) return 1;
+        *value = *value * 10 + d;
+    }
+    *text += n;
+    return 0;
+}
+
+// post: converts the YYYY-MM-DD at the start of text to days since
+// 1970-01-01
+// returns 0 on success, 1 if text doesn't start with a date
+static int parse_date(const char *text, long *days) {
+    int year, month, day;
+
+    if (parse_digits(&text, 4, &year) || *text++ != '-') return 1;
+    if (parse_digits(&text, 2, &month) || *text++ != '-') return 1;
+    if (parse_digits(&text, 2, &day)) return 1;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return 1;
+
+    *days = days_from_civil(year, month, day);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef __GPX_DECODE_H__
+#define __GPX_DECODE_H__
+
+// Decoding of GPX field text into numbers.
+//
+// gpx_strtod gives exactly the result strtod would (correctly rounded),
+// but handles the short decimals found in GPX files without calling the
+// C library.  gpx_decode_time converts timestamps to epoch seconds and
+// remembers the date part of the last one, since the points of a track
+// nearly all share a date with the point before.
+
+// length of the YYYY-MM-DD date part of a timestamp
+#define GPX_DATE_LENGTH (10)
+
+// the date part of the last timestamp decoded with a cache; zero it
+// before first use
+typedef struct {
+    char date[GPX_DATE_LENGTH];     // not '\0' terminated
+    long days;                      // days from 1970-01-01 to date
+} gpx_date_cache;
+
+
+/**
+ * Converts the initial part of the given string to a double, exactly as
+ * strtod does.
+ *
+ * @param text a string, non-NULL
+ * @param end where to store a pointer to the first character not
+ * converted (text itself if there is no number), or NULL
+ * @return the converted value, 0.0 if there is no number
+ */
+double gpx_strtod(const char *text, char **end);
+
+
+/**
+ * Converts an ISO-8601 UTC timestamp such as 2022-10-01T14:05:09Z (or
+ * with fractional seconds or a +hh:mm offset) to seconds since
+ * 1970-01-01T00:00:00Z.
+ *
+ * @param text a string, non-NULL
+ * @param cache a pointer to the cache to use, or NULL for none
+ * @param time a pointer to where to store the result, non-NULL
+ * @return 0 on success, 1 if text isn't a timestamp
+ */
+int gpx_decode_time(const char *text, gpx_date_cache *cache, long *time);
+
+
+/**
+ * Same as gpx_decode_time without a cache.
+ *
+ * @param text a string, non-NULL
+ * @param time a pointer to where to store the result, non-NULL
+ * @return 0 on success, 1 if text isn't a timestamp
+ */
+int gpx_parse_time(const char *text, long *time);
+
+#endif
@@ -0,0 +1,521 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Table-driven, single-pass extraction of trkpt fields from GPX input
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "gpx_input.h"
+#include "gpx_index.h"
+#include "gpx_extract.h"
+
+// trie nodes: every transition out of DEAD leads back to it
+#define DEAD (0)
+#define ATTRIBUTE_ROOT (1)
+#define ELEMENT_ROOT (2)
+
+// what a trie node accepts, other than the index of a field
+#define NO_MATCH (-1)
+#define STOP_POINT (-2)
+#define STOP_SEGMENT (-3)
+
+// how a tag ended
+#define TAG_OPEN (0)        // >
+#define TAG_EMPTY (1)       // />
+
+#define INITIAL_VALUE_SIZE (64)
+
+typedef struct {
+    int kind;
+    char *value;            // '\0' terminated
+    size_t length;
+    size_t capacity;
+    int found;
+    gpx_field_test test;    // NULL for none
+    void *test_arg;
+} field;
+
+struct gpx_extractor {
+    short (*next)[256];     // next[node][byte] is the node after byte
+    short *accept;          // accept[node] is a field index or code
+    int num_nodes;
+    int capacity;           // nodes allocated
+
+    field fields[GPX_MAX_FIELDS];
+    int num_fields;
+    int rejected;           // 1 once a test rejects the current trkpt
+
+    int pending;            // tag found inside a trkpt, to return next
+    int in_tag;             // 1 if the input is inside the last tag found
+    size_t tag_offset;      // offset of the '<' of the last tag found
+};
+
+// bytes that end a tag or attribute name
+static const char ends_name[256] = {
+    [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1,
+    ['>'] = 1, ['/'] = 1, ['='] = 1, ['<'] = 1, ['"'] = 1, ['\''] = 1
+};
+
+static int new_node(gpx_extractor *x);
+static int insert_name(gpx_extractor *x, int root, const char *name, int fold_case, int code);
+static int read_name(const gpx_extractor *x, gpx_input *in, int root, int strip_prefix);
+static int read_attributes(gpx_extractor *x, gpx_input *in);
+static void test_field(gpx_extractor *x, field *f);
+static int end_point(gpx_extractor *x, int result);
+static int skip_tag(gpx_input *in);
+static int skip_markup(gpx_input *in);
+static int skip_until_closer(gpx_input *in, int repeated);
+static void skip_space(gpx_input *in);
+static int copy_until(gpx_input *in, char stop_char, field *f);
+static int append(field *f, const char *text, size_t length);
+
+
+gpx_extractor *gpx_extractor_create(void) {
+    gpx_extractor *x = calloc(1, sizeof(*x));
+    if (x == NULL) return NULL;
+
+    // DEAD and the two roots
+    for (int i = 0; i < 3; i++) {
+        if (new_node(x) < 0) {
+            gpx_extractor_destroy(x);
+            return NULL;
+        }
+    }
+
+    if (insert_name(x, ELEMENT_ROOT, "trkpt", 1, STOP_POINT)
+        || insert_name(x, ELEMENT_ROOT, "trkseg", 1, STOP_SEGMENT)) {
+        gpx_extractor_destroy(x);
+        return NULL;
+    }
+
+    return x;
+}
+
+int gpx_extractor_add_field(gpx_extractor *x, int kind, const char *name) {
+    if (x->num_fields == GPX_MAX_FIELDS || name[0] == '\0') return -1;
+
+    field *f = &x->fields[x->num_fields];
+    f->value = malloc(INITIAL_VALUE_SIZE);
+    if (f->value == NULL) return -1;
+    f->value[0] = '\0';
+    f->capacity = INITIAL_VALUE_SIZE;
+    f->length = 0;
+    f->found = 0;
+    f->kind = kind;
+    f->test = NULL;
+
+    int root = kind == GPX_ATTRIBUTE ? ATTRIBUTE_ROOT : ELEMENT_ROOT;
+    if (insert_name(x, root, name, kind == GPX_ELEMENT, x->num_fields)) {
+        free(f->value);
+        f->value = NULL;
+        return -1;
+    }
+
+    return x->num_fields++;
+}
+
+void gpx_extractor_set_test(gpx_extractor *x, int field, gpx_field_test test, void *arg) {
+    x->fields[field].test = test;
+    x->fields[field].test_arg = arg;
+}
+
+void gpx_extractor_reset(gpx_extractor *x) {
+    x->pending = 0;
+    x->in_tag = 0;
+}
+
+int gpx_extract_next_tag(gpx_extractor *x, gpx_input *in) {
+    if (x->pending) {
+        int found = x->pending;
+        x->pending = 0;
+        return found;
+    }
+
+    // the rest of a trkseg tag, or of a trkpt that wasn't read
+    if (x->in_tag) {
+        x->in_tag = 0;
+        if (skip_tag(in) == EOF) return GPX_END;
+    }
+
+    while (1) {
+        // text between tags can't hold a '<'
+        if (copy_until(in, '<', NULL)) return GPX_END;
+        size_t tag_offset = gpx_input_offset(in) - 1;
+
+        int c = gpx_input_peek(in);
+        if (c == EOF) return GPX_END;
+        if (c == '/' || c == '?') {
+            if (copy_until(in, '>', NULL)) return GPX_END;
+            continue;
+        }
+        if (c == '!') {
+            if (skip_markup(in)) return GPX_END;
+            continue;
+        }
+
+        int code = read_name(x, in, ELEMENT_ROOT, 1);
+        if (code == STOP_POINT || code == STOP_SEGMENT) {
+            x->tag_offset = tag_offset;
+            x->in_tag = 1;
+            return code == STOP_POINT ? GPX_POINT : GPX_SEGMENT;
+        }
+
+        if (skip_tag(in) == EOF) return GPX_END;
+    }
+}
+
+int gpx_extract_point(gpx_extractor *x, gpx_input *in) {
+    for (int i = 0; i < x->num_fields; i++) {
+        x->fields[i].value[0] = '\0';
+        x->fields[i].length = 0;
+        x->fields[i].found = 0;
+    }
+    x->in_tag = 0;
+    x->rejected = 0;
+
+    int tag_end = read_attributes(x, in);
+    if (tag_end == EOF) return end_point(x, GPX_TRUNCATED);
+    if (tag_end == TAG_EMPTY) return end_point(x, GPX_COMPLETE);
+
+    // children: depth counts the elements open inside the trkpt, and
+    // capture is the field whose text comes next, if any
+    int depth = 0;
+    field *capture = NULL;
+    while (1) {
+        int ended = copy_until(in, '<', capture);
+        if (capture != NULL) test_field(x, capture);
+        capture = NULL;
+        if (ended) return end_point(x, GPX_TRUNCATED);
+        size_t tag_offset = gpx_input_offset(in) - 1;
+
+        int c = gpx_input_peek(in);
+        if (c == EOF) return end_point(x, GPX_TRUNCATED);
+        if (c == '/') {
+            if (copy_until(in, '>', NULL)) return end_point(x, GPX_TRUNCATED);
+            if (depth-- == 0) return end_point(x, GPX_COMPLETE);
+            continue;
+        }
+        if (c == '?') {
+            if (copy_until(in, '>', NULL)) return end_point(x, GPX_TRUNCATED);
+            continue;
+        }
+        if (c == '!') {
+            if (skip_markup(in)) return end_point(x, GPX_TRUNCATED);
+            continue;
+        }
+
+        int code = read_name(x, in, ELEMENT_ROOT, 1);
+        if (code == STOP_POINT || code == STOP_SEGMENT) {
+            // this trkpt was never closed; the tag is the next one found
+            x->pending = code == STOP_POINT ? GPX_POINT : GPX_SEGMENT;
+            x->in_tag = 1;
+            x->tag_offset = tag_offset;
+            return end_point(x, GPX_COMPLETE);
+        }
+
+        tag_end = skip_tag(in);
+        if (tag_end == EOF) return end_point(x, GPX_TRUNCATED);
+        if (tag_end == TAG_OPEN) depth++;
+
+        if (code >= 0 && x->fields[code].kind == GPX_ELEMENT && !x->fields[code].found
+            && !x->rejected) {
+            x->fields[code].found = 1;
+            if (tag_end == TAG_OPEN) capture = &x->fields[code];
+            else test_field(x, &x->fields[code]);
+        }
+    }
+}
+
+const char *gpx_extractor_value(const gpx_extractor *x, int field, size_t *length) {
+    if (length != NULL) *length = x->fields[field].length;
+    return x->fields[field].value;
+}
+
+int gpx_extractor_found(const gpx_extractor *x, int field) {
+    return x->fields[field].found;
+}
+
+size_t gpx_extractor_tag_offset(const gpx_extractor *x) {
+    return x->tag_offset;
+}
+
+size_t gpx_extractor_offset(const gpx_extractor *x, const gpx_input *in) {
+    if (x->pending || x->in_tag) return x->tag_offset;
+    return gpx_input_offset(in);
+}
+
+void gpx_extractor_destroy(gpx_extractor *x) {
+    if (x == NULL) return;
+
+    for (int i = 0; i < x->num_fields; i++) free(x->fields[i].value);
+    free(x->next);
+    free(x->accept);
+    free(x);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: adds a trie node whose transitions all lead to DEAD
+// returns the new node, or -1 if allocation fails
+static int new_node(gpx_extractor *x) {
+    if (x->num_nodes == x->capacity) {
+        int capacity = x->capacity == 0 ? 32 : x->capacity * 2;
+        short (*next)[256] = realloc(x->next, sizeof(*next) * capacity);
+        if (next == NULL) return -1;
+        x->next = next;
+
+        short *accept = realloc(x->accept, sizeof(*accept) * capacity);
+        if (accept == NULL) return -1;
+        x->accept = accept;
+
+        x->capacity = capacity;
+    }
+
+    memset(x->next[x->num_nodes], 0, sizeof(x->next[x->num_nodes]));
+    x->accept[x->num_nodes] = NO_MATCH;
+    return x->num_nodes++;
+}
+
+// post: adds the path for name from root, making its last node accept
+// code; with fold_case, upper and lower case bytes share each step
+// returns 0 on success, 1 if the name is invalid or already there
+static int insert_name(gpx_extractor *x, int root, const char *name, int fold_case, int code) {
+    int node = root;
+
+    for (const char *p = name; *p != '\0'; p++) {
+        unsigned char c = *p;
+        if (fold_case) c = tolower(c);
+        if (ends_name[c] || c == ':') return 1;
+
+        if (x->next[node][c] == DEAD) {
+            int child = new_node(x);
+            if (child < 0) return 1;
+            x->next[node][c] = child;
+            if (fold_case) x->next[node][toupper(c)] = child;
+        }
+        node = x->next[node][c];
+    }
+
+    if (x->accept[node] != NO_MATCH) return 1;
+    x->accept[node] = code;
+    return 0;
+}
+
+// post: reads a name from the input, one trie step per byte, stopping
+// before the first byte that ends it; with strip_prefix, a ':' starts
+// the name over so that a namespace prefix is ignored
+// returns what the name's node accepts
+static int read_name(const gpx_extractor *x, gpx_input *in, int root, int strip_prefix) {
+    int node = root;
+    int c;
+
+    while ((c = gpx_input_peek(in)) != EOF && !ends_name[c]) {
+        in->pos++;
+        if (c == ':' && strip_prefix) node = root;
+        else node = x->next[node][c];
+    }
+
+    return x->accept[node];
+}
+
+// pre: input is in a trkpt start tag, just past the element type
+// post: reads the attributes to the end of the tag, copying the values
+// of attribute fields
+// returns TAG_OPEN or TAG_EMPTY for how the tag ended, EOF if it didn't
+static int read_attributes(gpx_extractor *x, gpx_input *in) {
+    int c;
+
+    while ((c = gpx_input_peek(in)) != EOF) {
+        if (ends_name[c]) {
+            in->pos++;
+            if (c == '>') return TAG_OPEN;
+            if (c == '/' && gpx_input_peek(in) == '>') {
+                in->pos++;
+                return TAG_EMPTY;
+            }
+            // a stray value
+            if ((c == '"' || c == '\'') && copy_until(in, c, NULL)) return EOF;
+            continue;
+        }
+
+        int code = read_name(x, in, ATTRIBUTE_ROOT, 0);
+
+        // name = "value", maybe with spaces around the =
+        skip_space(in);
+        if (gpx_input_peek(in) != '=') continue;
+        in->pos++;
+        skip_space(in);
+
+        int quote = gpx_input_peek(in);
+        if (quote != '"' && quote != '\'') continue;
+        in->pos++;
+
+        field *f = NULL;
+        if (code >= 0 && x->fields[code].kind == GPX_ATTRIBUTE && !x->fields[code].found
+            && !x->rejected) {
+            f = &x->fields[code];
+            f->found = 1;
+        }
+        int ended = copy_until(in, quote, f);
+        if (f != NULL) test_field(x, f);
+        if (ended) return EOF;
+    }
+
+    return EOF;
+}
+
+// post: runs the field's test, if it has one and the trkpt hasn't
+// already been rejected, on its value
+static void test_field(gpx_extractor *x, field *f) {
+    if (f->test != NULL && !x->rejected && f->test(f->value, f->length, f->test_arg)) {
+        x->rejected = 1;
+    }
+}
+
+// post: runs the tests of the fields the trkpt didn't have, on ""
+// returns GPX_REJECTED if the trkpt was rejected, else result
+static int end_point(gpx_extractor *x, int result) {
+    for (int i = 0; i < x->num_fields && !x->rejected; i++) {
+        if (!x->fields[i].found) test_field(x, &x->fields[i]);
+    }
+
+    return x->rejected ? GPX_REJECTED : result;
+}
+
+// post: reads the rest of a tag, up to and including its '>', skipping
+// over quoted values
+// returns TAG_OPEN or TAG_EMPTY for how the tag ended, EOF if it didn't
+static int skip_tag(gpx_input *in) {
+    int c, last = 0, quote = 0;
+
+    // most tags skipped are just a name, so the '>' comes next
+    if (in->pos < in->end && *in->pos == '>') {
+        in->pos++;
+        return TAG_OPEN;
+    }
+
+    // a block at a time through the structural index while the window
+    // holds one: the first '>' outside quotes ends the tag
+    while (in->end - in->pos >= GPX_INDEX_BLOCK) {
+        gpx_block_index idx;
+        gpx_index_block(in->pos, &idx);
+        uint64_t closers = idx.gt & ~gpx_index_quote_mask(&idx, ~(uint64_t) 0, &quote);
+
+        if (closers != 0) {
+            int i = __builtin_ctzll(closers);
+            if (i > 0) last = (unsigned char) in->pos[i - 1];
+            in->pos += i + 1;
+            return last == '/' ? TAG_EMPTY : TAG_OPEN;
+        }
+        last = (unsigned char) in->pos[GPX_INDEX_BLOCK - 1];
+        in->pos += GPX_INDEX_BLOCK;
+    }
+
+    // the rest a byte at a time, finishing any quoted value left open
+    if (quote) {
+        if (copy_until(in, quote, NULL)) return EOF;
+        last = quote;
+    }
+    while ((c = gpx_input_getc(in)) != EOF) {
+        if (c == '>') return last == '/' ? TAG_EMPTY : TAG_OPEN;
+        if (c == '"' || c == '\'') {
+            if (copy_until(in, c, NULL)) return EOF;
+        }
+        last = c;
+    }
+
+    return EOF;
+}
+
+// pre: input is just past "<" and the next byte is '!'
+// post: reads a comment, CDATA section or declaration
+// returns 0 on success, 1 at end of input
+static int skip_markup(gpx_input *in) {
+    in->pos++;
+
+    int c = gpx_input_peek(in);
+    if (c == '-') return skip_until_closer(in, '-');
+    if (c == '[') return skip_until_closer(in, ']');
+    return copy_until(in, '>', NULL);
+}
+
+// post: reads input up to and including two or more of the repeated
+// byte followed by '>', not counting the repeated bytes that open the
+// markup ("<!--" or "<![")
+// returns 0 on success, 1 at end of input
+static int skip_until_closer(gpx_input *in, int repeated) {
+    // the opening bytes
+    int opening = repeated == '-' ? 2 : 1;
+    for (int i = 0; i < opening; i++) {
+        if (gpx_input_getc(in) == EOF) return 1;
+    }
+
+    int c, run = 0;
+    while ((c = gpx_input_getc(in)) != EOF) {
+        if (c == '>' && run >= 2) return 0;
+        run = c == repeated ? run + 1 : 0;
+    }
+
+    return 1;
+}
+
+// post: reads past any whitespace
+static void skip_space(gpx_input *in) {
+    int c;
+    while ((c = gpx_input_peek(in)) != EOF && isspace(c)) in->pos++;
+}
+
+// post: reads input up to and including stop_char, appending what comes
+// before it to the field's value if f isn't NULL.  A value that can't
+// grow is dropped rather than cut short, and the field marked not found
+// returns 0 if stop_char is found
+// returns 1 if end of file is reached first
+static int copy_until(gpx_input *in, char stop_char, field *f) {
+    while (in->pos < in->end || gpx_input_refill(in)) {
+        const char *run_start = in->pos;
+        const char *stop = memchr(run_start, stop_char, in->end - run_start);
+        const char *run_end = stop != NULL ? stop : in->end;
+
+        if (f != NULL && append(f, run_start, run_end - run_start)) {
+            f->value[0] = '\0';
+            f->length = 0;
+            f->found = 0;
+            f = NULL;
+        }
+
+        if (stop != NULL) {
+            in->pos = stop + 1;
+            return 0;
+        }
+        in->pos = in->end;
+    }
+
+    return 1;
+}
+
+// post: appends text to the field's value, growing it as needed
+// returns 0 on success, 1 if the value couldn't grow (it is then left
+// as it was)
+static int append(field *f, const char *text, size_t length) {
+    if (f->length + length + 1 > f->capacity) {
+        size_t capacity = f->capacity * 2;
+        while (capacity < f->length + length + 1) capacity *= 2;
+
+        char *value = realloc(f->value, capacity);
+        if (value == NULL) return 1;
+        f->value = value;
+        f->capacity = capacity;
+    }
+
+    memcpy(f->value + f->length, text, length);
+    f->length += length;
+    f->value[f->length] = '\0';
+    return 0;
+}
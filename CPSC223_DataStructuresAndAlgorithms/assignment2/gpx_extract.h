@@ -0,0 +1,167 @@
+#ifndef __GPX_EXTRACT_H__
+#define __GPX_EXTRACT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gpx_input.h"
+
+// Single-pass extraction of trkpt fields from GPX input.
+//
+// The names of the fields wanted, along with trkpt and trkseg, are
+// compiled into a table-driven trie.  The input is then read forward
+// once: text is skipped with memchr, each tag or attribute name walks
+// the trie one table lookup per byte, and a name that reaches an
+// accepting node has its value copied out.  Nothing is scanned twice
+// and nothing recurses, and adding fields only adds trie nodes, so the
+// cost per byte stays the same.
+//
+// Element names match in any case and after any namespace prefix (so
+// "hr" matches <gpxtpx:hr>); attribute names match exactly.  Only the
+// attributes of the trkpt tag itself are fields.  An element field
+// takes the text up to the next '<', as the first such element inside
+// the trkpt.  A trkpt ends at the end tag that closes it, or at the
+// next trkpt or trkseg start tag if it is never closed.
+//
+// A field can be given a test, run as soon as its value is complete.
+// Once a test rejects a trkpt, the rest of it is only skipped over: no
+// more values are copied out and no more tests are run.
+
+// what gpx_extract_next_tag found
+#define GPX_END (0)
+#define GPX_SEGMENT (1)
+#define GPX_POINT (2)
+
+// kinds of field
+#define GPX_ATTRIBUTE (0)   // an attribute of the trkpt start tag
+#define GPX_ELEMENT (1)     // the text of an element inside the trkpt
+
+#define GPX_MAX_FIELDS (16)
+
+// what gpx_extract_point returns: the trkpt was read whole, the input
+// ended inside it, or a test rejected it
+#define GPX_COMPLETE (0)
+#define GPX_TRUNCATED (1)
+#define GPX_REJECTED (2)
+
+typedef struct gpx_extractor gpx_extractor;
+
+// a test of a field's value ("" if the field is missing); returns 0 to
+// keep the trkpt, 1 to reject it
+typedef int (*gpx_field_test)(const char *value, size_t length, void *arg);
+
+
+/**
+ * Creates an extractor with no fields.
+ *
+ * @return a pointer to the new extractor, or NULL if allocation fails
+ */
+gpx_extractor *gpx_extractor_create(void);
+
+
+/**
+ * Adds a field to extract from each trkpt.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param kind GPX_ATTRIBUTE or GPX_ELEMENT
+ * @param name the attribute name or element type, without < or
+ * namespace prefix, non-empty
+ * @return the index of the field, or -1 if it can't be added
+ */
+int gpx_extractor_add_field(gpx_extractor *x, int kind, const char *name);
+
+
+/**
+ * Sets the test run on the value of the given field of each trkpt.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param field a field index returned by gpx_extractor_add_field
+ * @param test the test, or NULL for none
+ * @param arg passed to the test as is
+ */
+void gpx_extractor_set_test(gpx_extractor *x, int field, gpx_field_test test, void *arg);
+
+
+/**
+ * Forgets any tag read but not yet returned, for use after the input
+ * has been moved with gpx_input_seek.  The input must then be outside
+ * of any tag.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ */
+void gpx_extractor_reset(gpx_extractor *x);
+
+
+/**
+ * Reads up to and including the name of the next trkpt or trkseg start
+ * tag.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param in a pointer to an input, non-NULL
+ * @return GPX_POINT or GPX_SEGMENT for what was found, or GPX_END at end
+ * of input
+ */
+int gpx_extract_next_tag(gpx_extractor *x, gpx_input *in);
+
+
+/**
+ * Reads the rest of the trkpt whose tag was just found by
+ * gpx_extract_next_tag, keeping the value of each field.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param in a pointer to an input, non-NULL
+ * @return GPX_COMPLETE if the trkpt was read, GPX_TRUNCATED if the
+ * input ended inside it (the fields found so far are kept), or
+ * GPX_REJECTED if a test rejected it (the values are then not all there)
+ */
+int gpx_extract_point(gpx_extractor *x, gpx_input *in);
+
+
+/**
+ * Returns the value of the given field of the last trkpt read, as raw
+ * text ending with '\0'.  A field that wasn't found is "".
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param field a field index returned by gpx_extractor_add_field
+ * @param length where to store the length of the value, or NULL
+ */
+const char *gpx_extractor_value(const gpx_extractor *x, int field, size_t *length);
+
+
+/**
+ * Returns 1 if the given field was found in the last trkpt read, else 0.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param field a field index returned by gpx_extractor_add_field
+ */
+int gpx_extractor_found(const gpx_extractor *x, int field);
+
+
+/**
+ * Returns the input offset of the '<' of the last tag returned by
+ * gpx_extract_next_tag.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ */
+size_t gpx_extractor_tag_offset(const gpx_extractor *x);
+
+
+/**
+ * Returns the input offset from which a reset extractor would find the
+ * same next tag as this one.  This is the input's own offset unless a
+ * tag has been started but not yet finished.
+ *
+ * @param x a pointer to an extractor, non-NULL
+ * @param in a pointer to the input x is reading, non-NULL
+ */
+size_t gpx_extractor_offset(const gpx_extractor *x, const gpx_input *in);
+
+
+/**
+ * Frees the given extractor.
+ *
+ * @param x a pointer to an extractor, or NULL
+ */
+void gpx_extractor_destroy(gpx_extractor *x);
+
+#endif
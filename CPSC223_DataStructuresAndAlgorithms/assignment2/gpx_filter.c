@@ -0,0 +1,99 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Bounding-box and time-window tests on trkpt fields
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "gpx_extract.h"
+#include "gpx_decode.h"
+#include "gpx_filter.h"
+
+static int test_lat(const char *value, size_t length, void *arg);
+static int test_lon(const char *value, size_t length, void *arg);
+static int test_time(const char *value, size_t length, void *arg);
+static int read_number(const char **text, double *value);
+
+
+int gpx_filter_set_box(gpx_filter *f, const char *text) {
+    double bounds[4];
+
+    for (int i = 0; i < 4; i++) {
+        if (read_number(&text, &bounds[i])) return 1;
+        if (*text != (i < 3 ? ',' : '\0')) return 1;
+        text++;
+    }
+    if (!(bounds[0] <= bounds[2])) return 1;
+
+    f->has_box = 1;
+    f->min_lat = bounds[0];
+    f->min_lon = bounds[1];
+    f->max_lat = bounds[2];
+    f->max_lon = bounds[3];
+    return 0;
+}
+
+int gpx_filter_set_time(gpx_filter *f, const char *text, int is_end) {
+    long time;
+    if (gpx_parse_time(text, &time)) return 1;
+
+    if (!f->has_window) {
+        f->has_window = 1;
+        f->start_time = LONG_MIN;
+        f->end_time = LONG_MAX;
+    }
+    if (is_end) f->end_time = time;
+    else f->start_time = time;
+    return 0;
+}
+
+void gpx_filter_apply(const gpx_filter *f, gpx_extractor *x, int lat, int lon, int time) {
+    if (f->has_box) {
+        gpx_extractor_set_test(x, lat, test_lat, (void *) f);
+        gpx_extractor_set_test(x, lon, test_lon, (void *) f);
+    }
+    if (f->has_window) gpx_extractor_set_test(x, time, test_time, (void *) f);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: returns 1 if the latitude isn't a number inside the box, else 0
+static int test_lat(const char *value, size_t length, void *arg) {
+    const gpx_filter *f = arg;
+    double lat;
+    return read_number(&value, &lat) || !(lat >= f->min_lat && lat <= f->max_lat);
+}
+
+// post: returns 1 if the longitude isn't a number inside the box, else 0
+static int test_lon(const char *value, size_t length, void *arg) {
+    const gpx_filter *f = arg;
+    double lon;
+    if (read_number(&value, &lon)) return 1;
+
+    // a box whose west edge is east of its east edge wraps around 180
+    if (f->min_lon > f->max_lon) return !(lon >= f->min_lon || lon <= f->max_lon);
+    return !(lon >= f->min_lon && lon <= f->max_lon);
+}
+
+// post: returns 1 if the time isn't a timestamp inside the window, else 0
+static int test_time(const char *value, size_t length, void *arg) {
+    const gpx_filter *f = arg;
+    long time;
+    return gpx_parse_time(value, &time) || time < f->start_time || time >= f->end_time;
+}
+
+// post: converts the number at *text, moving *text past it
+// returns 0 on success, 1 if there is no number there
+static int read_number(const char **text, double *value) {
+    char *end;
+    *value = gpx_strtod(*text, &end);
+    if (end == *text) return 1;
+    *text = end;
+    return 0;
+}
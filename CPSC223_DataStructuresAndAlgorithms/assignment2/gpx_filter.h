@@ -0,0 +1,57 @@
+#ifndef __GPX_FILTER_H__
+#define __GPX_FILTER_H__
+
+#include "gpx_extract.h"
+
+// Bounding-box and time-window filters on trkpts, pushed down into the
+// extractor as field tests: a trkpt is rejected as soon as its lat or
+// lon is decoded outside the box (or its time outside the window), and
+// the rest of it is skipped without copying its other fields.  A trkpt
+// missing a field that is filtered on is rejected.
+
+typedef struct {
+    int has_box;
+    double min_lat, min_lon;    // inclusive; min_lon is the west edge
+    double max_lat, max_lon;    // inclusive; max_lon is the east edge
+    int has_window;
+    long start_time;            // inclusive, seconds since the epoch
+    long end_time;              // exclusive
+} gpx_filter;
+
+
+/**
+ * Parses a box given as "min_lat,min_lon,max_lat,max_lon" into the
+ * given filter.  A min_lon greater than max_lon gives a box that
+ * crosses longitude 180, from min_lon east to max_lon.
+ *
+ * @param f a pointer to a filter, non-NULL
+ * @param text the box, non-NULL
+ * @return 0 on success, 1 if text isn't a box
+ */
+int gpx_filter_set_box(gpx_filter *f, const char *text);
+
+
+/**
+ * Parses a timestamp (see gpx_decode_time) into the start or end of
+ * the given filter's time window.  The other end is left open unless
+ * it has been set too.
+ *
+ * @param f a pointer to a filter, non-NULL
+ * @param text the timestamp, non-NULL
+ * @param is_end 0 to set the start of the window, 1 to set the end
+ * @return 0 on success, 1 if text isn't a timestamp
+ */
+int gpx_filter_set_time(gpx_filter *f, const char *text, int is_end);
+
+
+/**
+ * Sets the tests of the given extractor's fields to apply the filter.
+ *
+ * @param f a pointer to a filter, non-NULL; it must outlive x
+ * @param x a pointer to an extractor, non-NULL
+ * @param lat, lon, time the extractor's field indexes for the lat and
+ * lon attributes and time element
+ */
+void gpx_filter_apply(const gpx_filter *f, gpx_extractor *x, int lat, int lon, int time);
+
+#endif
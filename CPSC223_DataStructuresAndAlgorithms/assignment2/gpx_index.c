@@ -0,0 +1,166 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// SIMD / scalar structural character classification for GPX extraction
+
+#include <stdint.h>
+
+#include "gpx_index.h"
+
+#if !defined(GPX_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define GPX_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static uint64_t prefix_xor(uint64_t bits);
+
+#ifdef GPX_X86_SIMD
+static void index_block_sse2(const char *block, gpx_block_index *idx);
+static void index_block_avx2(const char *block, gpx_block_index *idx);
+static void pick_index_block(void) __attribute__((constructor));
+
+// picked before main, once we know what the CPU supports, so that the
+// threads parsing in parallel only ever read it
+static void (*index_block_impl)(const char *, gpx_block_index *) = NULL;
+#endif
+
+
+void gpx_index_block(const char *block, gpx_block_index *idx) {
+#ifdef GPX_X86_SIMD
+    index_block_impl(block, idx);
+#else
+    gpx_index_block_scalar(block, idx);
+#endif
+}
+
+void gpx_index_block_scalar(const char *block, gpx_block_index *idx) {
+    idx->lt = idx->gt = idx->eq = idx->dquote = idx->squote = 0;
+
+    for (int i = 0; i < GPX_INDEX_BLOCK; i++) {
+        uint64_t bit = (uint64_t) 1 << i;
+        switch (block[i]) {
+        case '<':  idx->lt |= bit;     break;
+        case '>':  idx->gt |= bit;     break;
+        case '=':  idx->eq |= bit;     break;
+        case '"':  idx->dquote |= bit; break;
+        case '\'': idx->squote |= bit; break;
+        }
+    }
+}
+
+uint64_t gpx_index_quote_mask(const gpx_block_index *idx, uint64_t valid, int *quote) {
+    uint64_t dquote = idx->dquote & valid;
+    uint64_t squote = idx->squote & valid;
+
+    // fast path: only one kind of quote can open or close in this block,
+    // so quoted regions are exactly the runs between pairs of quotes
+    if ((squote == 0 && *quote != '\'') || (dquote == 0 && *quote != '"')) {
+        uint64_t quotes = squote == 0 ? dquote : squote;
+        uint64_t inside = prefix_xor(quotes);
+        if (*quote) inside = ~inside;
+
+        // still inside at the last valid byte?
+        uint64_t last = valid & ~(valid >> 1);
+        if (inside & last) {
+            if (!*quote) *quote = squote == 0 ? '"' : '\'';
+        }
+        else *quote = 0;
+
+        return (inside | quotes) & valid;
+    }
+
+    // slow path: both kinds appear, and a ' inside "..." (or the other
+    // way around) doesn't count, so resolve the quotes one at a time
+    uint64_t mask = 0;
+    uint64_t quotes = dquote | squote;
+    int open_at = 0;
+    while (quotes) {
+        int i = __builtin_ctzll(quotes);
+        quotes &= quotes - 1;
+        int c = (dquote >> i) & 1 ? '"' : '\'';
+
+        if (*quote == 0) {
+            *quote = c;
+            open_at = i;
+        }
+        else if (*quote == c) {
+            // bits open_at .. i inclusive
+            mask |= (~(uint64_t) 0 >> (63 - i)) & (~(uint64_t) 0 << open_at);
+            *quote = 0;
+        }
+    }
+    if (*quote) mask |= ~(uint64_t) 0 << open_at;
+
+    return mask & valid;
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: returns bits where bit i is the xor of bits 0..i of the argument
+static uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+#ifdef GPX_X86_SIMD
+
+// post: points index_block_impl at the widest version the CPU supports
+static void pick_index_block(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) index_block_impl = index_block_avx2;
+    else index_block_impl = index_block_sse2;
+}
+
+static void index_block_sse2(const char *block, gpx_block_index *idx) {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i eq = _mm_set1_epi8('=');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+
+    idx->lt = idx->gt = idx->eq = idx->dquote = idx->squote = 0;
+
+    for (int i = 0; i < GPX_INDEX_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (block + i));
+        idx->lt |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, lt)) << i;
+        idx->gt |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, gt)) << i;
+        idx->eq |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, eq)) << i;
+        idx->dquote |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, dquote)) << i;
+        idx->squote |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, squote)) << i;
+    }
+}
+
+__attribute__((target("avx2")))
+static void index_block_avx2(const char *block, gpx_block_index *idx) {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i eq = _mm256_set1_epi8('=');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+
+    __m256i lo = _mm256_loadu_si256((const __m256i *) block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *) (block + 32));
+
+#define AVX2_MASK(c) \
+    ((uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c)) \
+     | (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c)) << 32)
+
+    idx->lt = AVX2_MASK(lt);
+    idx->gt = AVX2_MASK(gt);
+    idx->eq = AVX2_MASK(eq);
+    idx->dquote = AVX2_MASK(dquote);
+    idx->squote = AVX2_MASK(squote);
+
+#undef AVX2_MASK
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __GPX_INDEX_H__
+#define __GPX_INDEX_H__
+
+#include <stdint.h>
+
+// Structural index for the GPX extractor.
+//
+// A 64-byte block of input is classified in one pass, giving a bitmask
+// per structural character: bit i is set when byte i of the block is
+// that character.  The extractor then looks only at the set bits
+// instead of every byte, as when it skips to the end of a tag.  AVX2 or
+// SSE2 is used when the CPU has it; the scalar version gives identical
+// masks and is used everywhere else, or always when compiled with
+// -DGPX_NO_SIMD.
+
+#define GPX_INDEX_BLOCK (64)
+
+typedef struct {
+    uint64_t lt;        // '<'
+    uint64_t gt;        // '>'
+    uint64_t eq;        // '='
+    uint64_t dquote;    // '"'
+    uint64_t squote;    // '\''
+} gpx_block_index;
+
+
+/**
+ * Classifies the structural characters of the given block.
+ *
+ * @param block a pointer to GPX_INDEX_BLOCK readable bytes
+ * @param idx a pointer to the index to fill in
+ */
+void gpx_index_block(const char *block, gpx_block_index *idx);
+
+
+/**
+ * Same as gpx_index_block, but never uses SIMD instructions.
+ *
+ * @param block a pointer to GPX_INDEX_BLOCK readable bytes
+ * @param idx a pointer to the index to fill in
+ */
+void gpx_index_block_scalar(const char *block, gpx_block_index *idx);
+
+
+/**
+ * Returns the mask of bytes of the given block that are inside a quoted
+ * string, including the opening and closing quotes.  A string opened by
+ * " is closed only by " and one opened by ' only by '.  Only the bytes
+ * in valid are considered.
+ *
+ * @param idx a pointer to an index filled in by gpx_index_block
+ * @param valid the mask of bytes that hold input
+ * @param quote a pointer to the quote state carried between blocks: 0
+ * outside quotes, otherwise the quote character that opened the string.
+ * Updated to the state after the last valid byte.
+ * @return the in-quote mask
+ */
+uint64_t gpx_index_quote_mask(const gpx_block_index *idx, uint64_t valid, int *quote);
+
+#endif
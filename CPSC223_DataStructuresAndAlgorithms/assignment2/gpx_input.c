@@ -0,0 +1,620 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Memory-mapped / prefetched (and decompressed) block input for the GPX
+// parser
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef GPX_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gpx_input.h"
+
+// room in front of each block's data for the bytes carried over from the
+// block before: up to GPX_INPUT_KEEP already read, plus fewer than
+// GPX_INPUT_BLOCK_SIZE unread (see gpx_input_ensure)
+#define CARRY_SPACE (GPX_INPUT_BLOCK_SIZE + GPX_INPUT_KEEP)
+
+// compressed bytes read at a time, and the first bytes looked at to tell
+// what the input is
+#define SOURCE_BUFFER_SIZE (1 << 16)
+#define MAGIC_LENGTH (4)
+
+// what the reader thread found the source to be
+#define SOURCE_PLAIN (0)
+#define SOURCE_GZIP (1)
+#define SOURCE_ZSTD (2)
+
+typedef struct {
+    char *buffer;           // CARRY_SPACE + GPX_INPUT_BLOCK_SIZE bytes
+    size_t length;          // bytes read in after the carry space
+    int last;               // 1 if the input ended after this block
+} block;
+
+// the two blocks of a streamed input and the thread filling them.  The
+// parser's window is in blocks[current]; the thread appends to the
+// other block until the parser takes it, so slow sources like pipes
+// still build up a whole block ahead of the parser.
+struct gpx_prefetch {
+    block blocks[2];
+    int current;            // the parser's block
+    int reading;            // 1 while the thread is in read()
+    int stop;               // set to make the reader thread exit; -1
+                            // until the thread is running
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+
+    // used only by the reader thread: bytes read from the source but not
+    // yet used, which for plain input are just the first few looked at
+    int source_type;
+    unsigned char *source;  // SOURCE_BUFFER_SIZE bytes
+    size_t source_length;
+    int source_ended;       // 1 once read() returned 0
+    z_stream zs;
+    int zs_started;
+    int zs_between;         // 1 if the last gzip member read is complete
+#ifdef GPX_ZSTD
+    ZSTD_DStream *zstd;     // NULL unless the input is zstd
+    int zstd_pending;       // 1 if the last output filled its block, so
+                            // the decoder may hold more
+    int zstd_between;       // 1 if the last zstd frame read is complete
+#endif
+};
+
+static gpx_input *open_input(const char *path, int may_map);
+static gpx_input *input_create(int fd, int owns_fd);
+static int try_map(gpx_input *in);
+static int start_prefetch(gpx_input *in);
+static void stop_prefetch(gpx_input *in);
+static void *prefetch_reader(void *arg);
+static int detect_source(gpx_input *in);
+static int read_source(gpx_input *in);
+static int fill_block(gpx_input *in, const block *b, size_t *added);
+static int inflate_block(gpx_prefetch *p, const block *b, size_t *added);
+#ifdef GPX_ZSTD
+static int zstd_block(gpx_prefetch *p, const block *b, size_t *added);
+#endif
+static int source_type(const unsigned char *bytes, size_t length);
+static void wait_for_input(int fd);
+
+
+gpx_input *gpx_input_open(const char *path) {
+    return open_input(path, 1);
+}
+
+gpx_input *gpx_input_open_stream(const char *path) {
+    return open_input(path, 0);
+}
+
+gpx_input *gpx_input_from_memory(const char *data, size_t len) {
+    gpx_input *in = input_create(-1, 0);
+    if (in == NULL) return NULL;
+
+    in->base = in->pos = data;
+    in->end = data + len;
+    in->eof = 1;
+
+    return in;
+}
+
+int gpx_input_is_mapped(const gpx_input *in) {
+    return in->buffer == NULL;
+}
+
+size_t gpx_input_ensure(gpx_input *in, size_t n) {
+    gpx_prefetch *p = in->prefetch;
+
+    while ((size_t) (in->end - in->pos) < n && !in->eof) {
+        // wait for the reader thread to put something in the other
+        // block, and to be out of read() so it can be taken
+        int next = 1 - p->current;
+        block *b = &p->blocks[next];
+
+        pthread_mutex_lock(&p->lock);
+        while ((b->length == 0 && !b->last) || p->reading) {
+            pthread_cond_wait(&p->changed, &p->lock);
+        }
+
+        // carry the unread bytes, and a few before them, to just in
+        // front of the new data
+        size_t behind = in->pos - in->base;
+        if (behind > GPX_INPUT_KEEP) behind = GPX_INPUT_KEEP;
+
+        const char *keep_from = in->pos - behind;
+        size_t keep_len = in->end - keep_from;
+        char *data = b->buffer + CARRY_SPACE;
+        memcpy(data - keep_len, keep_from, keep_len);
+
+        in->base_offset += keep_from - in->base;
+        in->buffer = b->buffer;
+        in->base = data - keep_len;
+        in->pos = in->base + behind;
+        in->end = data + b->length;
+        if (b->last) in->eof = 1;
+
+        // hand the old block back to the reader thread
+        p->blocks[p->current].length = 0;
+        p->current = next;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    return in->end - in->pos;
+}
+
+int gpx_input_refill(gpx_input *in) {
+    return gpx_input_ensure(in, 1) > 0;
+}
+
+size_t gpx_input_offset(const gpx_input *in) {
+    return in->base_offset + (in->pos - in->base);
+}
+
+void gpx_input_seek(gpx_input *in, size_t offset) {
+    in->pos = in->base + (offset - in->base_offset);
+}
+
+void gpx_input_close(gpx_input *in) {
+    if (in == NULL) return;
+
+    if (in->mapped_length > 0) munmap((void *) in->base, in->mapped_length);
+    stop_prefetch(in);
+    if (in->owns_fd) close(in->fd);
+    free(in);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: opens the given file (stdin for NULL or "-"), mapping it if
+// may_map and it can be, else starting the reader thread
+// returns NULL (and prints a message to stderr) on failure
+static gpx_input *open_input(const char *path, int may_map) {
+    int fd;
+    int owns_fd;
+
+    if (path == NULL || strcmp(path, "-") == 0) {
+        fd = STDIN_FILENO;
+        owns_fd = 0;
+    }
+    else {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return NULL;
+        }
+        owns_fd = 1;
+    }
+
+    gpx_input *in = input_create(fd, owns_fd);
+    if (in == NULL) {
+        if (owns_fd) close(fd);
+        return NULL;
+    }
+
+    // stdin may itself be a redirected regular file, so try mapping it too
+    if (may_map && try_map(in)) return in;
+
+    if (start_prefetch(in)) {
+        gpx_input_close(in);
+        return NULL;
+    }
+
+    return in;
+}
+
+// post: returns a new, empty input reading from fd
+// returns NULL if allocation fails
+static gpx_input *input_create(int fd, int owns_fd) {
+    gpx_input *in = malloc(sizeof(*in));
+    if (in == NULL) return NULL;
+
+    in->pos = in->end = in->base = NULL;
+    in->base_offset = 0;
+    in->buffer = NULL;
+    in->mapped_length = 0;
+    in->fd = fd;
+    in->owns_fd = owns_fd;
+    in->eof = 0;
+    in->error = 0;
+    in->prefetch = NULL;
+
+    return in;
+}
+
+// post: maps in->fd into memory if it is a non-empty regular file
+// returns 1 if mapped (the window then covers the whole file)
+// returns 0 if the caller should fall back to block reads
+static int try_map(gpx_input *in) {
+    struct stat info;
+
+    if (fstat(in->fd, &info) < 0 || !S_ISREG(info.st_mode)) return 0;
+
+    // an empty file has nothing to map; it is simply at end of input
+    if (info.st_size == 0) {
+        in->eof = 1;
+        return 1;
+    }
+
+    // stdin might not be at the start of the file
+    off_t start = lseek(in->fd, 0, SEEK_CUR);
+    if (start < 0) start = 0;
+    if (start >= info.st_size) {
+        in->eof = 1;
+        return 1;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+    if (data == MAP_FAILED) return 0;
+
+    // compressed files go through the reader thread to be decompressed
+    if (source_type((const unsigned char *) data + start, info.st_size - start) != SOURCE_PLAIN) {
+        munmap(data, info.st_size);
+        return 0;
+    }
+
+    // the scanners read front to back, so ask for aggressive readahead
+    posix_madvise(data, info.st_size, POSIX_MADV_SEQUENTIAL);
+
+    in->mapped_length = info.st_size;
+    in->base = data;
+    in->pos = (const char *) data + start;
+    in->end = (const char *) data + info.st_size;
+    in->eof = 1;
+
+    return 1;
+}
+
+// post: allocates the blocks and starts the reader thread, with an
+// empty window in one block while the thread fills the other
+// returns 0 on success, 1 on failure
+static int start_prefetch(gpx_input *in) {
+    gpx_prefetch *p = calloc(1, sizeof(*p));
+    if (p == NULL) return 1;
+    p->stop = -1;
+    in->prefetch = p;
+
+    for (int i = 0; i < 2; i++) {
+        p->blocks[i].buffer = malloc(CARRY_SPACE + GPX_INPUT_BLOCK_SIZE);
+        if (p->blocks[i].buffer == NULL) return 1;
+    }
+    p->source = malloc(SOURCE_BUFFER_SIZE);
+    if (p->source == NULL) return 1;
+    p->current = 1;
+
+    in->buffer = p->blocks[1].buffer;
+    in->base = in->pos = in->end = in->buffer + CARRY_SPACE;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->changed, NULL);
+    p->stop = 0;
+    if (pthread_create(&p->thread, NULL, prefetch_reader, in) != 0) {
+        fprintf(stderr, "couldn't start reader thread\n");
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->changed);
+        p->stop = -1;
+        return 1;
+    }
+
+    return 0;
+}
+
+// post: stops the reader thread, if any, and frees the blocks
+static void stop_prefetch(gpx_input *in) {
+    gpx_prefetch *p = in->prefetch;
+    if (p == NULL) return;
+
+    if (p->stop != -1) {
+        pthread_mutex_lock(&p->lock);
+        p->stop = 1;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+
+        // the thread may be waiting in poll() for input that will never
+        // come, which is the only place it can be cancelled
+        pthread_cancel(p->thread);
+        pthread_join(p->thread, NULL);
+
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->changed);
+    }
+
+    if (p->zs_started) inflateEnd(&p->zs);
+#ifdef GPX_ZSTD
+    ZSTD_freeDStream(p->zstd);
+#endif
+    free(p->source);
+    free(p->blocks[0].buffer);
+    free(p->blocks[1].buffer);
+    free(p);
+    in->prefetch = NULL;
+    in->buffer = NULL;
+}
+
+// post: appends to the block the parser isn't using until the input
+// ends or the thread is stopped, waiting while that block is full
+static void *prefetch_reader(void *arg) {
+    gpx_input *in = arg;
+    gpx_prefetch *p = in->prefetch;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    int result = detect_source(in);
+    while (result > 0) {
+        pthread_mutex_lock(&p->lock);
+        while (!p->stop && p->blocks[1 - p->current].length == GPX_INPUT_BLOCK_SIZE) {
+            pthread_cond_wait(&p->changed, &p->lock);
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        // wait for input without holding a block, so the parser can take
+        // what is already there in the meantime
+        if (p->source_length == 0 && !p->source_ended) {
+            wait_for_input(in->fd);
+            if (p->source_type != SOURCE_PLAIN && read_source(in) < 0) {
+                result = -1;
+                break;
+            }
+        }
+
+        // the parser may have taken the block while we waited
+        pthread_mutex_lock(&p->lock);
+        if (p->stop) {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        block *b = &p->blocks[1 - p->current];
+        if (b->length == GPX_INPUT_BLOCK_SIZE) {
+            pthread_mutex_unlock(&p->lock);
+            continue;
+        }
+        p->reading = 1;
+        pthread_mutex_unlock(&p->lock);
+
+        size_t added = 0;
+        result = fill_block(in, b, &added);
+
+        pthread_mutex_lock(&p->lock);
+        p->reading = 0;
+        b->length += added;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    // the input ended, or couldn't be read further
+    pthread_mutex_lock(&p->lock);
+    p->blocks[1 - p->current].last = 1;
+    if (result < 0) in->error = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+// post: reads the first few bytes of the input to tell whether it is
+// compressed, setting up to decompress it if so
+// returns 1 if there is input to read, 0 if it is empty, -1 on failure
+static int detect_source(gpx_input *in) {
+    gpx_prefetch *p = in->prefetch;
+
+    while (p->source_length < MAGIC_LENGTH && !p->source_ended) {
+        wait_for_input(in->fd);
+        if (read_source(in) < 0) return -1;
+    }
+    if (p->source_length == 0) return 0;
+
+    p->source_type = source_type(p->source, p->source_length);
+    if (p->source_type == SOURCE_ZSTD) {
+#ifdef GPX_ZSTD
+        p->zstd = ZSTD_createDStream();
+        if (p->zstd == NULL || ZSTD_isError(ZSTD_initDStream(p->zstd))) {
+            fprintf(stderr, "couldn't start decompressing\n");
+            return -1;
+        }
+#else
+        fprintf(stderr, "zstd-compressed input needs a build with ZSTD=1; decompress it first\n");
+        return -1;
+#endif
+    }
+    if (p->source_type == SOURCE_GZIP) {
+        // 16 + MAX_WBITS: expect a gzip header rather than a zlib one
+        if (inflateInit2(&p->zs, 16 + MAX_WBITS) != Z_OK) {
+            fprintf(stderr, "couldn't start decompressing\n");
+            return -1;
+        }
+        p->zs_started = 1;
+        p->zs.next_in = p->source;
+        p->zs.avail_in = p->source_length;
+    }
+    return 1;
+}
+
+// post: appends what the source has to give (without waiting) to the
+// unused source bytes, setting source_ended if it has ended
+// returns 0 on success, -1 if read() failed
+static int read_source(gpx_input *in) {
+    gpx_prefetch *p = in->prefetch;
+
+    // move what inflate hasn't used to the front
+    if (p->zs_started && p->zs.avail_in > 0 && p->zs.next_in != p->source) {
+        memmove(p->source, p->zs.next_in, p->zs.avail_in);
+    }
+    if (p->zs_started) p->source_length = p->zs.avail_in;
+
+    ssize_t num_read;
+    do {
+        num_read = read(in->fd, p->source + p->source_length,
+                        SOURCE_BUFFER_SIZE - p->source_length);
+    } while (num_read < 0 && errno == EINTR);
+
+    if (num_read < 0) {
+        perror("read");
+        return -1;
+    }
+    if (num_read == 0) p->source_ended = 1;
+    p->source_length += num_read;
+
+    if (p->zs_started) {
+        p->zs.next_in = p->source;
+        p->zs.avail_in = p->source_length;
+    }
+    return 0;
+}
+
+// pre: the calling thread is the only one writing to b's data
+// post: writes the next of the input after b's data, setting *added to
+// the number of bytes written (the caller adds them to b->length)
+// returns 1 if there may be more input, 0 at its end, -1 on failure
+static int fill_block(gpx_input *in, const block *b, size_t *added) {
+    gpx_prefetch *p = in->prefetch;
+    char *data = b->buffer + CARRY_SPACE + b->length;
+    size_t space = GPX_INPUT_BLOCK_SIZE - b->length;
+
+    if (p->source_type == SOURCE_GZIP) return inflate_block(p, b, added);
+#ifdef GPX_ZSTD
+    if (p->source_type == SOURCE_ZSTD) return zstd_block(p, b, added);
+#endif
+
+    // the bytes read to tell what the input was come first
+    if (p->source_length > 0) {
+        size_t length = p->source_length < space ? p->source_length : space;
+        memcpy(data, p->source, length);
+        memmove(p->source, p->source + length, p->source_length - length);
+        p->source_length -= length;
+        *added = length;
+        return 1;
+    }
+    if (p->source_ended) return 0;
+
+    ssize_t num_read;
+    do {
+        num_read = read(in->fd, data, space);
+    } while (num_read < 0 && errno == EINTR);
+
+    if (num_read < 0) {
+        perror("read");
+        return -1;
+    }
+    if (num_read == 0) return 0;
+    *added = num_read;
+    return 1;
+}
+
+// pre: the calling thread is the only one writing to b's data
+// post: decompresses as much of the source bytes read so far as fits
+// after b's data, straight into the block, setting *added
+// returns 1 if there may be more input, 0 at its end, -1 on failure
+static int inflate_block(gpx_prefetch *p, const block *b, size_t *added) {
+    z_stream *zs = &p->zs;
+    size_t space = GPX_INPUT_BLOCK_SIZE - b->length;
+
+    zs->next_out = (unsigned char *) b->buffer + CARRY_SPACE + b->length;
+    zs->avail_out = space;
+
+    int status = Z_OK;
+    while (zs->avail_out > 0 && zs->avail_in > 0) {
+        status = inflate(zs, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            // another member may follow, as with concatenated .gz files
+            inflateReset(zs);
+            p->zs_between = 1;
+            continue;
+        }
+        if (status != Z_OK) break;
+        p->zs_between = 0;
+    }
+
+    *added = space - zs->avail_out;
+    p->source_length = zs->avail_in;
+
+    if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+        fprintf(stderr, "corrupt compressed input: %s\n", zs->msg != NULL ? zs->msg : "inflate failed");
+        return -1;
+    }
+
+    if (zs->avail_in == 0 && p->source_ended) {
+        if (!p->zs_between) {
+            fprintf(stderr, "compressed input ends early\n");
+            return -1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef GPX_ZSTD
+
+// pre: the calling thread is the only one writing to b's data
+// post: decompresses as much of the source bytes read so far as fits
+// after b's data, as inflate_block does for gzip, moving the bytes not
+// used yet to the front of the source
+// returns 1 if there may be more input, 0 at its end, -1 on failure
+static int zstd_block(gpx_prefetch *p, const block *b, size_t *added) {
+    ZSTD_outBuffer out = {b->buffer + CARRY_SPACE + b->length, GPX_INPUT_BLOCK_SIZE - b->length, 0};
+    ZSTD_inBuffer src = {p->source, p->source_length, 0};
+
+    // the decoder can have output left over from the last call even when
+    // there is no new input
+    while (out.pos < out.size && (src.pos < src.size || p->zstd_pending)) {
+        size_t status = ZSTD_decompressStream(p->zstd, &out, &src);
+        if (ZSTD_isError(status)) {
+            fprintf(stderr, "corrupt compressed input: %s\n", ZSTD_getErrorName(status));
+            return -1;
+        }
+        // another frame may follow, as with concatenated .zst files
+        p->zstd_between = status == 0;
+        p->zstd_pending = out.pos == out.size;
+    }
+
+    *added = out.pos;
+    memmove(p->source, p->source + src.pos, src.size - src.pos);
+    p->source_length = src.size - src.pos;
+
+    if (p->source_length == 0 && p->source_ended && !p->zstd_pending) {
+        if (!p->zstd_between) {
+            fprintf(stderr, "compressed input ends early\n");
+            return -1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+#endif
+
+// post: returns SOURCE_GZIP or SOURCE_ZSTD if the given first bytes of an
+// input start a compressed stream of that kind, else SOURCE_PLAIN
+static int source_type(const unsigned char *bytes, size_t length) {
+    if (length >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) return SOURCE_GZIP;
+    if (length >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f
+        && bytes[3] == 0xfd) {
+        return SOURCE_ZSTD;
+    }
+    return SOURCE_PLAIN;
+}
+
+// post: waits until fd has input (or has ended); the thread can be
+// cancelled only while it waits here
+static void wait_for_input(int fd) {
+    struct pollfd ready = {fd, POLLIN, 0};
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    while (poll(&ready, 1, -1) < 0 && errno == EINTR) continue;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+}
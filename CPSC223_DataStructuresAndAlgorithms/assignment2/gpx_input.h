@@ -0,0 +1,163 @@
+#ifndef __GPX_INPUT_H__
+#define __GPX_INPUT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Input layer for the GPX parser.
+//
+// Regular files are mapped into memory, so the whole file is one window
+// and the scanners read the bytes in place.  Pipes, terminals and stdin
+// can't be mapped, so they are streamed: a reader thread reads the next
+// block into a second buffer while the scanners work through the
+// current one, so waiting for input overlaps with parsing.  Files can
+// be streamed the same way instead of mapped (gpx_input_open_stream).
+//
+// gzip-compressed input (a .gpx.gz file, or one piped in) is found by
+// its first bytes and always streamed: the reader thread decompresses
+// straight into the block the scanners will get next, so decompressing
+// overlaps with parsing too.  zstd-compressed input (.gpx.zst) is read
+// the same way when built with ZSTD=1, which needs libzstd; otherwise it
+// is recognised, reported and ends the input.
+
+// largest read() for inputs that are streamed
+#define GPX_INPUT_BLOCK_SIZE (1 << 20)
+
+// bytes kept from the previous block when the window slides, so the
+// scanners can look a short way behind the current byte
+#define GPX_INPUT_KEEP (256)
+
+typedef struct gpx_input gpx_input;
+typedef struct gpx_prefetch gpx_prefetch;
+
+// the window fields are public so gpx_input_getc and gpx_input_peek can
+// be inlined into the scanners' per-byte loops.  Only gpx_input.c
+// should write to them.
+struct gpx_input {
+    const char *pos;        // next unread byte in the window
+    const char *end;        // one past the last valid byte in the window
+
+    char *buffer;           // current block buffer (NULL when mapped)
+    size_t mapped_length;   // length of mapping (0 when not mapped)
+    const char *base;       // start of mapping or buffer
+    size_t base_offset;     // offset in the input of the byte at base
+    int fd;
+    int owns_fd;            // 1 if gpx_input_close should close fd
+    int eof;                // 1 once the source has nothing more to give
+    int error;              // 1 if a read failed (the input then ends)
+    gpx_prefetch *prefetch; // reader thread state (NULL when mapped)
+};
+
+
+/**
+ * Opens the given file for scanning.  A NULL path or "-" reads from
+ * stdin.  Uncompressed regular files are memory-mapped; anything else
+ * falls back to block reads.  Returns NULL (and prints a message to stderr) if the
+ * file can't be opened.
+ *
+ * @param path the name of a file, "-", or NULL
+ * @return a pointer to the new input, or NULL
+ */
+gpx_input *gpx_input_open(const char *path);
+
+
+/**
+ * Opens the given file like gpx_input_open, but always streams it
+ * through the reader thread rather than mapping it.  For one pass over
+ * a cold file this keeps the disk busy while the parser runs, where a
+ * mapping would stall on each page it hasn't read yet.
+ *
+ * @param path the name of a file, "-", or NULL
+ * @return a pointer to the new input, or NULL
+ */
+gpx_input *gpx_input_open_stream(const char *path);
+
+
+/**
+ * Makes an input that scans the given bytes in place.  The caller keeps
+ * ownership of the bytes, which must outlive the input.
+ *
+ * @param data a pointer to len bytes; may be NULL if len is 0
+ * @param len the number of bytes
+ * @return a pointer to the new input
+ */
+gpx_input *gpx_input_from_memory(const char *data, size_t len);
+
+
+/**
+ * Returns 1 if the whole input is available as one contiguous range
+ * (a mapped file or a memory input), 0 if it is being read in blocks.
+ *
+ * @param in a pointer to an input, non-NULL
+ */
+int gpx_input_is_mapped(const gpx_input *in);
+
+
+/**
+ * Moves the window forward to the next block read by the reader thread,
+ * waiting for it if needed, until at least n unread bytes are available
+ * or the input ends.  The last GPX_INPUT_KEEP bytes
+ * before pos stay in the window.  Pointers into the window other than
+ * pos and end are invalid afterwards.  n must be at most
+ * GPX_INPUT_BLOCK_SIZE.
+ *
+ * @param in a pointer to an input, non-NULL
+ * @param n the number of bytes wanted
+ * @return the number of unread bytes available, less than n only at end
+ * of input
+ */
+size_t gpx_input_ensure(gpx_input *in, size_t n);
+
+
+/**
+ * Reads the next block if the current window is used up.
+ *
+ * @param in a pointer to an input, non-NULL
+ * @return 1 if unread bytes are available, 0 at end of input
+ */
+int gpx_input_refill(gpx_input *in);
+
+
+/**
+ * Returns the offset in the input of the next unread byte.
+ *
+ * @param in a pointer to an input, non-NULL
+ */
+size_t gpx_input_offset(const gpx_input *in);
+
+
+/**
+ * Moves to the given offset of a mapped or memory input.
+ *
+ * @param in a pointer to an input for which gpx_input_is_mapped is true
+ * @param offset an offset no larger than the length of the input
+ */
+void gpx_input_seek(gpx_input *in, size_t offset);
+
+
+/**
+ * Closes the given input, unmapping or freeing its window and stopping
+ * its reader thread.
+ *
+ * @param in a pointer to an input, or NULL
+ */
+void gpx_input_close(gpx_input *in);
+
+
+// post: returns next byte of input and advances past it
+// returns EOF if input is exhausted
+static inline int gpx_input_getc(gpx_input *in)
+{
+    if (in->pos == in->end && !gpx_input_refill(in)) return EOF;
+    return (unsigned char) *in->pos++;
+}
+
+// post: returns next byte of input without advancing past it
+// returns EOF if input is exhausted
+static inline int gpx_input_peek(gpx_input *in)
+{
+    if (in->pos == in->end && !gpx_input_refill(in)) return EOF;
+    return (unsigned char) *in->pos;
+}
+
+#endif
@@ -0,0 +1,235 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Lock-free single-producer, single-consumer ring of decoded trkpts
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "gpx_reader.h"
+#include "gpx_pipe.h"
+
+// fields written by different threads are kept this far apart so
+// neither thread's writes evict the other's cache line
+#define CACHE_LINE (64)
+
+// times a thread checks again (yielding in between) before it sleeps
+#define SPIN_COUNT (64)
+
+struct gpx_pipe {
+    gpx_record *records;    // num_batches batches of GPX_PIPE_BATCH
+    int *lengths;           // records in each published batch
+    int num_batches;
+
+    gpx_reader *reader;     // read by the producer thread, if started
+    pthread_t thread;
+    int started;
+
+    // waking a thread that has gone to sleep
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int num_sleeping;       // atomic
+
+    // written by the producer
+    char producer_line[CACHE_LINE];
+    unsigned long head;     // atomic: batches published
+    int closed;             // atomic: 1 once nothing more will be
+    int filled;             // records put in the batch at head
+
+    // written by the consumer
+    char consumer_line[CACHE_LINE];
+    unsigned long tail;     // atomic: batches handed back
+    int gone;               // atomic: 1 once the consumer has gone away
+    int taken;              // records taken from the batch at tail
+    int holding;            // 1 if the batch at tail is being read
+
+    char end_line[CACHE_LINE];
+};
+
+static void *produce(void *arg);
+static int has_room(gpx_pipe *p);
+static int has_batch(gpx_pipe *p);
+static void wait_until(gpx_pipe *p, int (*ready)(gpx_pipe *));
+static void wake(gpx_pipe *p);
+
+
+gpx_pipe *gpx_pipe_create(int num_batches) {
+    if (num_batches < 2) return NULL;
+
+    gpx_pipe *p = calloc(1, sizeof(*p));
+    if (p == NULL) return NULL;
+
+    p->records = malloc(sizeof(*p->records) * GPX_PIPE_BATCH * num_batches);
+    p->lengths = malloc(sizeof(*p->lengths) * num_batches);
+    if (p->records == NULL || p->lengths == NULL) {
+        free(p->records);
+        free(p->lengths);
+        free(p);
+        return NULL;
+    }
+    p->num_batches = num_batches;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->changed, NULL);
+    return p;
+}
+
+int gpx_pipe_start(gpx_pipe *p, gpx_reader *r) {
+    p->reader = r;
+    if (pthread_create(&p->thread, NULL, produce, p) != 0) return 1;
+    p->started = 1;
+    return 0;
+}
+
+int gpx_pipe_put(gpx_pipe *p, const gpx_record *rec) {
+    if (p->filled == 0) {
+        wait_until(p, has_room);
+        if (__atomic_load_n(&p->gone, __ATOMIC_SEQ_CST)) return 1;
+    }
+
+    int slot = p->head % p->num_batches;
+    p->records[slot * GPX_PIPE_BATCH + p->filled++] = *rec;
+
+    if (p->filled == GPX_PIPE_BATCH) {
+        p->lengths[slot] = p->filled;
+        p->filled = 0;
+        __atomic_store_n(&p->head, p->head + 1, __ATOMIC_SEQ_CST);
+        wake(p);
+    }
+    return 0;
+}
+
+void gpx_pipe_close(gpx_pipe *p) {
+    if (p->filled > 0) {
+        p->lengths[p->head % p->num_batches] = p->filled;
+        p->filled = 0;
+        __atomic_store_n(&p->head, p->head + 1, __ATOMIC_SEQ_CST);
+    }
+    __atomic_store_n(&p->closed, 1, __ATOMIC_SEQ_CST);
+    wake(p);
+}
+
+int gpx_pipe_get(gpx_pipe *p, gpx_record *rec) {
+    int slot = p->tail % p->num_batches;
+
+    if (p->holding && p->taken == p->lengths[slot]) {
+        // hand the batch back before waiting for the next
+        p->holding = 0;
+        __atomic_store_n(&p->tail, p->tail + 1, __ATOMIC_SEQ_CST);
+        wake(p);
+        slot = p->tail % p->num_batches;
+    }
+
+    if (!p->holding) {
+        wait_until(p, has_batch);
+        if (__atomic_load_n(&p->head, __ATOMIC_SEQ_CST) == p->tail) return 0;
+        p->holding = 1;
+        p->taken = 0;
+    }
+
+    *rec = p->records[slot * GPX_PIPE_BATCH + p->taken++];
+    return 1;
+}
+
+void gpx_record_set(gpx_record *rec, int kind, const gpx_point *pt) {
+    rec->kind = kind;
+    if (kind != GPX_POINT) {
+        rec->has_location = rec->has_elevation = rec->has_time = 0;
+        return;
+    }
+
+    rec->has_location = pt->has_location;
+    rec->latitude = pt->latitude;
+    rec->longitude = pt->longitude;
+    rec->has_elevation = pt->has_elevation;
+    rec->elevation = pt->elevation;
+    rec->has_time = pt->has_time;
+    rec->epoch_time = pt->epoch_time;
+}
+
+void gpx_pipe_destroy(gpx_pipe *p) {
+    if (p == NULL) return;
+
+    if (p->started) {
+        __atomic_store_n(&p->gone, 1, __ATOMIC_SEQ_CST);
+        wake(p);
+        pthread_join(p->thread, NULL);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->changed);
+    free(p->records);
+    free(p->lengths);
+    free(p);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: puts every segment and trkpt of the reader into the pipe, then
+// closes it; stops early if the consumer goes away
+static void *produce(void *arg) {
+    gpx_pipe *p = arg;
+    gpx_point pt;
+    gpx_record rec;
+
+    int found;
+    while ((found = gpx_read_next(p->reader, &pt)) != GPX_END) {
+        gpx_record_set(&rec, found, &pt);
+        if (gpx_pipe_put(p, &rec)) break;
+    }
+
+    gpx_pipe_close(p);
+    return NULL;
+}
+
+// returns 1 if the producer can fill the batch at head, or the consumer
+// has gone away
+static int has_room(gpx_pipe *p) {
+    return p->head - __atomic_load_n(&p->tail, __ATOMIC_SEQ_CST) < (unsigned long) p->num_batches
+           || __atomic_load_n(&p->gone, __ATOMIC_SEQ_CST);
+}
+
+// returns 1 if the batch at tail is published, or the pipe is closed
+static int has_batch(gpx_pipe *p) {
+    // closed is set after the last batch is published, so it is read
+    // first: once it is seen, head is final
+    int closed = __atomic_load_n(&p->closed, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&p->head, __ATOMIC_SEQ_CST) != p->tail || closed;
+}
+
+// post: returns once ready(p) is true.  The calling thread spins for a
+// while, then sleeps until the other thread calls wake.
+static void wait_until(gpx_pipe *p, int (*ready)(gpx_pipe *)) {
+    for (int i = 0; i < SPIN_COUNT; i++) {
+        if (ready(p)) return;
+        sched_yield();
+    }
+
+    // a thread changes the pipe before it checks num_sleeping, and one
+    // about to sleep counts itself before it checks the pipe, so one of
+    // them always sees the other; the lock makes the wakeup wait until
+    // the sleeper is in pthread_cond_wait
+    pthread_mutex_lock(&p->lock);
+    __atomic_add_fetch(&p->num_sleeping, 1, __ATOMIC_SEQ_CST);
+    while (!ready(p)) pthread_cond_wait(&p->changed, &p->lock);
+    __atomic_sub_fetch(&p->num_sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// pre: the calling thread has just changed the pipe
+// post: wakes the other thread if it is asleep
+static void wake(gpx_pipe *p) {
+    if (__atomic_load_n(&p->num_sleeping, __ATOMIC_SEQ_CST) == 0) return;
+
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,115 @@
+#ifndef __GPX_PIPE_H__
+#define __GPX_PIPE_H__
+
+#include "gpx_reader.h"
+
+// Single-producer, single-consumer pipe of decoded trkpts, so parsing
+// can run on one core while a consumer (building a track, gathering
+// statistics) runs on another.
+//
+// The pipe is a ring of batches of GPX_PIPE_BATCH records.  The
+// producer fills a batch in place and publishes it with one atomic
+// store; the consumer reads it in place and hands it back the same way,
+// so the two threads share a cache line once a batch rather than once a
+// record, and never take a lock while the other keeps up.  When the
+// ring is full the producer waits, so a slow consumer holds the parser
+// back instead of letting records pile up; when it is empty the
+// consumer waits.  A thread that has to wait spins briefly, then sleeps
+// until the other wakes it.
+//
+// One thread may call gpx_pipe_put and gpx_pipe_close, and one other
+// thread gpx_pipe_get; gpx_pipe_start runs the producer side on a new
+// thread that reads from a gpx_reader.
+
+// records in a batch
+#define GPX_PIPE_BATCH (256)
+
+// batches in the ring unless another number is asked for
+#define GPX_PIPE_DEFAULT_BATCHES (16)
+
+// the decoded fields of a trkpt, or the start of a segment
+typedef struct {
+    int kind;                   // GPX_POINT or GPX_SEGMENT
+    char has_location;
+    char has_elevation;
+    char has_time;
+    double latitude;
+    double longitude;
+    double elevation;
+    long epoch_time;
+} gpx_record;
+
+typedef struct gpx_pipe gpx_pipe;
+
+
+/**
+ * Creates an empty pipe holding up to the given number of batches.
+ *
+ * @param num_batches the number of batches in the ring, at least 2
+ * @return a pointer to the new pipe, or NULL if num_batches is too
+ * small or allocation fails
+ */
+gpx_pipe *gpx_pipe_create(int num_batches);
+
+
+/**
+ * Starts a thread that reads every segment and trkpt from the given
+ * reader into the pipe, then closes it.  The reader must not be used
+ * by anyone else until the pipe is destroyed.
+ *
+ * @param p a pointer to a pipe nothing has been put into, non-NULL
+ * @param r a pointer to a reader, non-NULL
+ * @return 0 on success, 1 if the thread can't be started
+ */
+int gpx_pipe_start(gpx_pipe *p, gpx_reader *r);
+
+
+/**
+ * Adds a record to the pipe, waiting for room if it is full.  Records
+ * are only seen by the consumer a batch at a time, or on
+ * gpx_pipe_close.
+ *
+ * @param p a pointer to a pipe, non-NULL
+ * @param rec a pointer to the record, non-NULL
+ * @return 0 on success, 1 if the consumer has gone away
+ */
+int gpx_pipe_put(gpx_pipe *p, const gpx_record *rec);
+
+
+/**
+ * Lets the consumer see the records put so far, and no more after them.
+ *
+ * @param p a pointer to a pipe, non-NULL
+ */
+void gpx_pipe_close(gpx_pipe *p);
+
+
+/**
+ * Takes the next record, waiting for one if none is ready.
+ *
+ * @param p a pointer to a pipe, non-NULL
+ * @param rec a pointer to where to copy the record, non-NULL
+ * @return 1 if a record was taken, 0 once the pipe is closed and empty
+ */
+int gpx_pipe_get(gpx_pipe *p, gpx_record *rec);
+
+
+/**
+ * Sets the given record to the decoded fields of a point.
+ *
+ * @param rec a pointer to a record, non-NULL
+ * @param kind GPX_POINT or GPX_SEGMENT (pt is then ignored)
+ * @param pt a pointer to a point, non-NULL
+ */
+void gpx_record_set(gpx_record *rec, int kind, const gpx_point *pt);
+
+
+/**
+ * Frees the given pipe.  A producer thread still running is told the
+ * consumer has gone away and is waited for.
+ *
+ * @param p a pointer to a pipe, or NULL
+ */
+void gpx_pipe_destroy(gpx_pipe *p);
+
+#endif
@@ -0,0 +1,258 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Reads trkseg and trkpt elements out of GPX input one at a time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpx_input.h"
+#include "gpx_decode.h"
+#include "gpx_extract.h"
+#include "gpx_filter.h"
+#include "gpx_reader.h"
+#include "gpx_simplify.h"
+
+#define INITIAL_LOG_SIZE (64)
+#define INITIAL_LOG_TEXT_SIZE (4096)
+
+// the text of a point the simplifier took, kept until it is let out
+typedef struct {
+    long number;
+    size_t offset;          // of its text in the log, lat, lon, ele and
+    size_t lengths[4];      // time one after another, each '\0' ended
+} logged_point;
+
+struct gpx_reader {
+    gpx_input *in;
+    gpx_extractor *extractor;
+    int lat, lon, ele, time;    // field indexes in extractor
+    gpx_date_cache date_cache;
+    long num_read;              // trkpts read so far
+
+    gpx_simplifier *simplifier;     // NULL unless simplifying
+    int next_tag;                   // tag to return once the simplifier
+                                    // is empty, or -1 for none
+
+    // the points the simplifier may still let out, oldest first, from
+    // log[first_logged] to log[num_logged - 1], and their text
+    logged_point *log;
+    int first_logged;
+    int num_logged;
+    int log_capacity;
+    char *log_text;
+    size_t log_text_length;
+    size_t log_text_capacity;
+
+    int failed;                 // 1 once the log couldn't grow
+};
+
+static int read_point(gpx_reader *r, gpx_point *pt);
+static void set_field(const gpx_reader *r, int field, const char **text, size_t *length);
+static int log_point(gpx_reader *r, const gpx_point *pt);
+static void take_logged(gpx_reader *r, gpx_point *pt);
+static void compact_log(gpx_reader *r);
+static int decode_number(const char *text, double *value);
+
+
+gpx_reader *gpx_reader_create(gpx_input *in) {
+    gpx_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) return NULL;
+
+    r->in = in;
+    r->next_tag = -1;
+    r->extractor = gpx_extractor_create();
+    if (r->extractor == NULL) {
+        free(r);
+        return NULL;
+    }
+
+    r->lat = gpx_extractor_add_field(r->extractor, GPX_ATTRIBUTE, "lat");
+    r->lon = gpx_extractor_add_field(r->extractor, GPX_ATTRIBUTE, "lon");
+    r->ele = gpx_extractor_add_field(r->extractor, GPX_ELEMENT, "ele");
+    r->time = gpx_extractor_add_field(r->extractor, GPX_ELEMENT, "time");
+    if (r->lat < 0 || r->lon < 0 || r->ele < 0 || r->time < 0) {
+        gpx_reader_destroy(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void gpx_reader_set_filter(gpx_reader *r, const gpx_filter *f) {
+    gpx_filter_apply(f, r->extractor, r->lat, r->lon, r->time);
+}
+
+int gpx_reader_set_simplify(gpx_reader *r, const gpx_simplify_options *opts) {
+    gpx_simplifier *s = gpx_simplifier_create(opts);
+    if (s == NULL) return 1;
+
+    gpx_simplifier_destroy(r->simplifier);
+    r->simplifier = s;
+    return 0;
+}
+
+int gpx_read_next(gpx_reader *r, gpx_point *pt) {
+    if (r->simplifier == NULL) return read_point(r, pt);
+
+    while (!r->failed) {
+        if (gpx_simplifier_next(r->simplifier, pt)) {
+            take_logged(r, pt);
+            return GPX_POINT;
+        }
+
+        if (r->next_tag >= 0) {
+            int tag = r->next_tag;
+            r->next_tag = -1;
+            return tag;
+        }
+
+        int found = read_point(r, pt);
+        if (found == GPX_POINT) {
+            // the extractor's text is gone by the time the point is let
+            // out, so the simplifier's points keep a copy
+            if (gpx_simplifier_add(r->simplifier, pt) && log_point(r, pt)) r->failed = 1;
+        }
+        else {
+            // the segment is over, so what it still holds is kept
+            gpx_simplifier_flush(r->simplifier);
+            r->next_tag = found;
+        }
+    }
+
+    return GPX_END;
+}
+
+int gpx_reader_failed(const gpx_reader *r) {
+    return r->failed;
+}
+
+void gpx_reader_destroy(gpx_reader *r) {
+    if (r == NULL) return;
+
+    gpx_extractor_destroy(r->extractor);
+    gpx_simplifier_destroy(r->simplifier);
+    free(r->log);
+    free(r->log_text);
+    free(r);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: reads up to the next trkseg or trkpt start tag, filling in pt
+// for a trkpt, as gpx_read_next does without simplifying
+// returns GPX_SEGMENT, GPX_POINT or GPX_END for what was found
+static int read_point(gpx_reader *r, gpx_point *pt) {
+    int found;
+    do {
+        found = gpx_extract_next_tag(r->extractor, r->in);
+        if (found != GPX_POINT) return found;
+    } while (gpx_extract_point(r->extractor, r->in) == GPX_REJECTED);
+
+    set_field(r, r->lat, &pt->lat, &pt->lat_length);
+    set_field(r, r->lon, &pt->lon, &pt->lon_length);
+    set_field(r, r->ele, &pt->ele, &pt->ele_length);
+    set_field(r, r->time, &pt->time, &pt->time_length);
+    pt->number = r->num_read++;
+
+    pt->has_location = decode_number(pt->lat, &pt->latitude) == 0
+                       && decode_number(pt->lon, &pt->longitude) == 0;
+    pt->has_elevation = decode_number(pt->ele, &pt->elevation) == 0;
+    pt->has_time = gpx_decode_time(pt->time, &r->date_cache, &pt->epoch_time) == 0;
+
+    return GPX_POINT;
+}
+
+// post: points text at the value of the given field, which the
+// extractor keeps until the next trkpt, and sets its length
+static void set_field(const gpx_reader *r, int field, const char **text, size_t *length) {
+    *text = gpx_extractor_value(r->extractor, field, length);
+}
+
+// post: adds a copy of the text of pt to the end of the log
+// returns 0 on success, 1 if the log couldn't grow
+static int log_point(gpx_reader *r, const gpx_point *pt) {
+    const char *texts[] = {pt->lat, pt->lon, pt->ele, pt->time};
+    size_t lengths[] = {pt->lat_length, pt->lon_length, pt->ele_length, pt->time_length};
+    size_t total = lengths[0] + lengths[1] + lengths[2] + lengths[3] + 4;
+
+    if (r->num_logged == r->log_capacity
+        || r->log_text_length + total > r->log_text_capacity) {
+        compact_log(r);
+    }
+
+    if (r->num_logged == r->log_capacity) {
+        int capacity = r->log_capacity == 0 ? INITIAL_LOG_SIZE : r->log_capacity * 2;
+        logged_point *log = realloc(r->log, sizeof(*log) * capacity);
+        if (log == NULL) return 1;
+        r->log = log;
+        r->log_capacity = capacity;
+    }
+    if (r->log_text_length + total > r->log_text_capacity) {
+        size_t capacity = r->log_text_capacity == 0 ? INITIAL_LOG_TEXT_SIZE : r->log_text_capacity * 2;
+        while (capacity < r->log_text_length + total) capacity *= 2;
+        char *text = realloc(r->log_text, capacity);
+        if (text == NULL) return 1;
+        r->log_text = text;
+        r->log_text_capacity = capacity;
+    }
+
+    logged_point *entry = &r->log[r->num_logged++];
+    entry->number = pt->number;
+    entry->offset = r->log_text_length;
+    for (int i = 0; i < 4; i++) {
+        memcpy(r->log_text + r->log_text_length, texts[i], lengths[i]);
+        r->log_text[r->log_text_length + lengths[i]] = '\0';
+        r->log_text_length += lengths[i] + 1;
+        entry->lengths[i] = lengths[i];
+    }
+
+    return 0;
+}
+
+// pre: pt was let out by the simplifier
+// post: drops the logged points before pt, which were let out already or
+// never will be, and points the text of pt at its copy in the log
+static void take_logged(gpx_reader *r, gpx_point *pt) {
+    while (r->log[r->first_logged].number < pt->number) r->first_logged++;
+
+    const logged_point *entry = &r->log[r->first_logged];
+    const char *text = r->log_text + entry->offset;
+    const char **texts[] = {&pt->lat, &pt->lon, &pt->ele, &pt->time};
+    size_t *lengths[] = {&pt->lat_length, &pt->lon_length, &pt->ele_length, &pt->time_length};
+    for (int i = 0; i < 4; i++) {
+        *texts[i] = text;
+        *lengths[i] = entry->lengths[i];
+        text += entry->lengths[i] + 1;
+    }
+}
+
+// post: moves the logged points from the first one still wanted to the
+// front of the log, along with their text
+static void compact_log(gpx_reader *r) {
+    if (r->first_logged == 0) return;
+
+    int count = r->num_logged - r->first_logged;
+    size_t start = count > 0 ? r->log[r->first_logged].offset : r->log_text_length;
+
+    memmove(r->log, r->log + r->first_logged, sizeof(*r->log) * count);
+    memmove(r->log_text, r->log_text + start, r->log_text_length - start);
+    for (int i = 0; i < count; i++) r->log[i].offset -= start;
+
+    r->first_logged = 0;
+    r->num_logged = count;
+    r->log_text_length -= start;
+}
+
+// post: converts the number at the start of text
+// returns 0 on success, 1 if text doesn't start with a number
+static int decode_number(const char *text, double *value) {
+    char *end;
+    *value = gpx_strtod(text, &end);
+    return end == text;
+}
@@ -0,0 +1,103 @@
+#ifndef __GPX_READER_H__
+#define __GPX_READER_H__
+
+#include "gpx_input.h"
+#include "gpx_decode.h"
+#include "gpx_extract.h"
+#include "gpx_filter.h"
+
+// Pull interface for reading the track segments and points of a GPX
+// file one at a time, for programs that want the data rather than
+// parse_GPX's text output.
+
+typedef struct gpx_reader gpx_reader;
+typedef struct gpx_simplify_options gpx_simplify_options;
+
+// the fields of one trkpt, as text and decoded; a missing field is ""
+// and not valid.  The text is '\0' terminated and belongs to the
+// reader: it is only valid until the next gpx_read_next.
+typedef struct {
+    const char *lat;
+    const char *lon;
+    const char *ele;
+    const char *time;
+    size_t lat_length;
+    size_t lon_length;
+    size_t ele_length;
+    size_t time_length;
+
+    int has_location;           // 1 if lat and lon are both numbers
+    double latitude;
+    double longitude;
+    int has_elevation;
+    double elevation;
+    int has_time;
+    long epoch_time;            // seconds since 1970-01-01T00:00:00Z
+
+    long number;                // trkpts read before this one
+} gpx_point;
+
+
+/**
+ * Creates a reader for the given input.
+ *
+ * @param in a pointer to an input, non-NULL; the reader doesn't take
+ * ownership
+ * @return a pointer to the new reader, or NULL if allocation fails
+ */
+gpx_reader *gpx_reader_create(gpx_input *in);
+
+
+/**
+ * Makes the reader skip the trkpts the given filter rejects.
+ *
+ * @param r a pointer to a reader, non-NULL
+ * @param f a pointer to a filter, non-NULL; it must outlive r
+ */
+void gpx_reader_set_filter(gpx_reader *r, const gpx_filter *f);
+
+
+/**
+ * Makes the reader downsample the points of each segment (see
+ * gpx_simplify.h), returning only the points kept.
+ *
+ * @param r a pointer to a reader, non-NULL
+ * @param opts a pointer to the options, non-NULL
+ * @return 0 on success, 1 if the options are invalid or allocation fails
+ */
+int gpx_reader_set_simplify(gpx_reader *r, const gpx_simplify_options *opts);
+
+
+/**
+ * Reads up to the next trkseg or trkpt start tag.  For a trkpt, the
+ * whole element is read and its fields are put in the given point and
+ * decoded.  The fields are found the same way parse_GPX finds them.
+ * A trkpt rejected by the reader's filter is skipped.  When simplifying,
+ * the points kept are returned a little behind the input, but always
+ * before the trkseg tag (or end of input) that follows them.
+ *
+ * @param r a pointer to a reader, non-NULL
+ * @param pt a pointer to a point to fill in, non-NULL
+ * @return GPX_SEGMENT or GPX_POINT for what was found, or GPX_END at
+ * end of input
+ */
+int gpx_read_next(gpx_reader *r, gpx_point *pt);
+
+
+/**
+ * Returns 1 if the given reader stopped early because it couldn't
+ * allocate memory, else 0.  gpx_read_next then returns GPX_END.
+ *
+ * @param r a pointer to a reader, non-NULL
+ */
+int gpx_reader_failed(const gpx_reader *r);
+
+
+/**
+ * Frees the given reader, but not its input.
+ *
+ * @param r a pointer to a reader, or NULL
+ */
+void gpx_reader_destroy(gpx_reader *r);
+
+#endif
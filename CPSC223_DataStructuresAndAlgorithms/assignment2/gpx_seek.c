@@ -0,0 +1,241 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Builds, maps and searches sidecar seek indexes of GPX files
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gpx_input.h"
+#include "gpx_extract.h"
+#include "gpx_decode.h"
+#include "gpx_seek.h"
+
+#define INITIAL_ENTRIES (64)
+
+static int add_entry(gpx_seek_entry **entries, uint64_t *num_entries, uint64_t *capacity);
+static int write_index(const char *index_path, const gpx_seek_header *header,
+                       const gpx_seek_entry *entries);
+
+
+int gpx_seek_build(const char *gpx_path, int every, const char *index_path) {
+    gpx_input *in = gpx_input_open(gpx_path);
+    if (in == NULL) return 1;
+
+    struct stat info;
+    gpx_extractor *x = gpx_extractor_create();
+    int time_field = x != NULL ? gpx_extractor_add_field(x, GPX_ELEMENT, "time") : -1;
+    if (!gpx_input_is_mapped(in) || fstat(in->fd, &info) < 0 || time_field < 0) {
+        fprintf(stderr, "%s: can only index a regular file\n", gpx_path);
+        gpx_extractor_destroy(x);
+        gpx_input_close(in);
+        return 1;
+    }
+
+    gpx_seek_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GPX_SEEK_MAGIC, sizeof(GPX_SEEK_MAGIC));
+    header.version = GPX_SEEK_VERSION;
+    header.every = every;
+    header.file_size = info.st_size;
+    header.file_mtime = info.st_mtime;
+
+    gpx_seek_entry *entries = NULL;
+    uint64_t capacity = 0;
+    uint64_t segment = 0;
+    gpx_date_cache cache = {{0}};
+    int failed = 0;
+
+    // first pass: each entry gets the latest and earliest times of its
+    // own trkpts
+    int found;
+    while (!failed && (found = gpx_extract_next_tag(x, in)) != GPX_END) {
+        if (found == GPX_SEGMENT) {
+            segment++;
+            continue;
+        }
+
+        uint64_t offset = gpx_extractor_tag_offset(x);
+        gpx_extract_point(x, in);
+
+        long time;
+        int64_t t = GPX_SEEK_NO_TIME;
+        if (gpx_decode_time(gpx_extractor_value(x, time_field, NULL), &cache, &time) == 0) {
+            t = time;
+        }
+
+        if (header.num_points % every == 0) {
+            if (add_entry(&entries, &header.num_entries, &capacity)) {
+                failed = 1;
+                break;
+            }
+            gpx_seek_entry *e = &entries[header.num_entries - 1];
+            e->offset = offset;
+            e->segment = segment;
+            e->time = t;
+            e->max_time = INT64_MIN;
+            e->min_time = INT64_MAX;
+        }
+
+        gpx_seek_entry *e = &entries[header.num_entries - 1];
+        if (t != GPX_SEEK_NO_TIME) {
+            if (t > e->max_time) e->max_time = t;
+            if (t < e->min_time) e->min_time = t;
+        }
+        header.num_points++;
+    }
+    gpx_extractor_destroy(x);
+    gpx_input_close(in);
+
+    // second pass: make the latest times run forward and the earliest
+    // times run backward, so both only increase
+    for (uint64_t i = 1; i < header.num_entries; i++) {
+        if (entries[i - 1].max_time > entries[i].max_time) entries[i].max_time = entries[i - 1].max_time;
+    }
+    for (uint64_t i = header.num_entries; i-- > 1; ) {
+        if (entries[i].min_time < entries[i - 1].min_time) entries[i - 1].min_time = entries[i].min_time;
+    }
+
+    if (failed) fprintf(stderr, "out of memory\n");
+    else if (write_index(index_path, &header, entries)) {
+        fprintf(stderr, "%s: couldn't write index\n", index_path);
+        failed = 1;
+    }
+
+    free(entries);
+    return failed;
+}
+
+gpx_seek *gpx_seek_map(const char *index_path, const char *gpx_path) {
+    struct stat gpx_info;
+    if (stat(gpx_path, &gpx_info) < 0) return NULL;
+
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(gpx_seek_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    // check the file is an index of the GPX file as it is now
+    const gpx_seek_header *header = data;
+    if (memcmp(header->magic, GPX_SEEK_MAGIC, sizeof(GPX_SEEK_MAGIC)) != 0
+        || header->version != GPX_SEEK_VERSION
+        || header->num_entries > (uint64_t) info.st_size
+        || sizeof(*header) + header->num_entries * sizeof(gpx_seek_entry) != (uint64_t) info.st_size
+        || header->file_size != (uint64_t) gpx_info.st_size
+        || header->file_mtime != (int64_t) gpx_info.st_mtime) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+
+    gpx_seek *idx = malloc(sizeof(*idx));
+    if (idx == NULL) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+
+    idx->header = header;
+    idx->entries = (const gpx_seek_entry *) (header + 1);
+    idx->num_entries = header->num_entries;
+    idx->mapped_length = info.st_size;
+    return idx;
+}
+
+int gpx_seek_find(const gpx_seek *idx, int64_t from, int64_t to, uint64_t *begin, uint64_t *end) {
+    const gpx_seek_entry *e = idx->entries;
+    size_t n = idx->num_entries;
+
+    // the first entry whose trkpts (or earlier ones) reach from; those
+    // before it are all earlier
+    size_t low = 0, high = n;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (e[mid].max_time >= from) high = mid;
+        else low = mid + 1;
+    }
+    size_t first = low;
+
+    // the first entry after it from which every trkpt is at or past to
+    low = first + 1;
+    high = n;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (e[mid].min_time >= to) high = mid;
+        else low = mid + 1;
+    }
+    size_t last = low;
+
+    if (first == n || e[first].min_time >= to) return 0;
+
+    *begin = e[first].offset;
+    *end = last < n ? e[last].offset : UINT64_MAX;
+    return 1;
+}
+
+void gpx_seek_unmap(gpx_seek *idx) {
+    if (idx == NULL) return;
+
+    munmap((void *) idx->header, idx->mapped_length);
+    free(idx);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: adds room for one more entry at the end of *entries
+// returns 0 on success, 1 if allocation fails
+static int add_entry(gpx_seek_entry **entries, uint64_t *num_entries, uint64_t *capacity) {
+    if (*num_entries == *capacity) {
+        uint64_t bigger = *capacity == 0 ? INITIAL_ENTRIES : *capacity * 2;
+        gpx_seek_entry *grown = realloc(*entries, sizeof(**entries) * bigger);
+        if (grown == NULL) return 1;
+        *entries = grown;
+        *capacity = bigger;
+    }
+
+    (*num_entries)++;
+    return 0;
+}
+
+// post: writes the header and entries to the given file, replacing it in
+// one step so a reader never sees half an index
+// returns 0 on success, 1 on failure
+static int write_index(const char *index_path, const gpx_seek_header *header,
+                       const gpx_seek_entry *entries) {
+    size_t length = strlen(index_path) + 5;
+    char *temp_path = malloc(length);
+    if (temp_path == NULL) return 1;
+    snprintf(temp_path, length, "%s.new", index_path);
+
+    FILE *out = fopen(temp_path, "wb");
+    int failed = out == NULL;
+    if (!failed) {
+        failed = fwrite(header, sizeof(*header), 1, out) != 1
+                 || (header->num_entries > 0
+                     && fwrite(entries, sizeof(*entries), header->num_entries, out) != header->num_entries);
+        failed = fclose(out) != 0 || failed;
+    }
+    if (!failed) failed = rename(temp_path, index_path) != 0;
+    else remove(temp_path);
+
+    free(temp_path);
+    return failed;
+}
@@ -0,0 +1,97 @@
+#ifndef __GPX_SEEK_H__
+#define __GPX_SEEK_H__
+
+#include <stdint.h>
+
+// Sidecar seek index for a GPX file.
+//
+// The index holds one entry for every Nth trkpt: the offset of its tag,
+// the segment it is in and its time.  Times in a GPX file nearly always
+// increase, but nothing makes them, so each entry also has the latest
+// time of any trkpt up to the next entry and the earliest time of any
+// trkpt from it on.  Those increase whatever the times do, so a time
+// window can be found with two binary searches, and parsing can start
+// and stop at entries without missing a trkpt in the window.
+//
+// The file is a gpx_seek_header followed by the entries, in the byte
+// order of the machine that wrote it.
+
+#define GPX_SEEK_MAGIC "GPXIDX1"
+#define GPX_SEEK_VERSION (1)
+
+#define GPX_SEEK_NO_TIME INT64_MIN
+
+typedef struct {
+    char magic[8];              // GPX_SEEK_MAGIC, '\0' terminated
+    uint32_t version;
+    uint32_t every;             // trkpts per entry
+    uint64_t file_size;         // size and modification time of the
+    int64_t file_mtime;         // GPX file indexed
+    uint64_t num_points;
+    uint64_t num_entries;
+} gpx_seek_header;
+
+typedef struct {
+    uint64_t offset;            // of the entry's trkpt tag
+    uint64_t segment;           // trksegs before the trkpt
+    int64_t time;               // of the trkpt, or GPX_SEEK_NO_TIME
+    int64_t max_time;           // latest time up to the next entry, or
+                                // INT64_MIN if none has a time
+    int64_t min_time;           // earliest time from this entry on, or
+                                // INT64_MAX if none has a time
+} gpx_seek_entry;
+
+// an index mapped into memory
+typedef struct {
+    const gpx_seek_header *header;
+    const gpx_seek_entry *entries;
+    size_t num_entries;
+    size_t mapped_length;
+} gpx_seek;
+
+
+/**
+ * Reads the given GPX file and writes an index of it.
+ *
+ * @param gpx_path the name of a regular GPX file
+ * @param every the number of trkpts per entry, positive
+ * @param index_path the name of the index file to write
+ * @return 0 on success, 1 on failure (after printing a message)
+ */
+int gpx_seek_build(const char *gpx_path, int every, const char *index_path);
+
+
+/**
+ * Maps the given index of the given GPX file into memory.
+ *
+ * @param index_path the name of an index file
+ * @param gpx_path the name of the GPX file it should index
+ * @return a pointer to the mapped index, or NULL if it can't be opened,
+ * isn't an index, or was built for the file as it was before a change
+ */
+gpx_seek *gpx_seek_map(const char *index_path, const char *gpx_path);
+
+
+/**
+ * Finds the range of the GPX file that holds every trkpt whose time is
+ * in [from, to).
+ *
+ * @param idx a pointer to a mapped index, non-NULL
+ * @param from the start of the window, inclusive
+ * @param to the end of the window, exclusive
+ * @param begin where to store the offset to start parsing at
+ * @param end where to store the offset of the first trkpt tag past the
+ * range, or UINT64_MAX to parse to the end of the file
+ * @return 1 if the range may hold trkpts in the window, 0 if it can't
+ */
+int gpx_seek_find(const gpx_seek *idx, int64_t from, int64_t to, uint64_t *begin, uint64_t *end);
+
+
+/**
+ * Unmaps the given index.
+ *
+ * @param idx a pointer returned by gpx_seek_map, or NULL
+ */
+void gpx_seek_unmap(gpx_seek *idx);
+
+#endif
@@ -0,0 +1,230 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Streaming min-distance, min-interval and Douglas-Peucker downsampling
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "gpx_reader.h"
+#include "gpx_simplify.h"
+
+#define EARTH_RADIUS_M (6371000.0)
+#define PI (3.14159265358979)
+#define RADIANS(x) ((x) / 180.0 * PI)
+
+struct gpx_simplifier {
+    gpx_simplify_options opts;
+
+    gpx_point last;         // the last point past the first two filters
+    int has_last;           // 0 at the start of a segment
+
+    // Douglas-Peucker window: held[0] is the last point let out, and the
+    // rest are still undecided
+    gpx_point *held;
+    int num_held;
+    double *x, *y;          // held points projected around held[0]
+    char *keep;
+    int *stack;             // pairs of held indexes still to split
+
+    // points let out, in order, from ready[first] to ready[num_ready - 1]
+    gpx_point *ready;
+    int first_ready;
+    int num_ready;
+};
+
+static void simplify_window(gpx_simplifier *s, int final);
+static void mark_kept(gpx_simplifier *s);
+static double segment_distance(const gpx_simplifier *s, int i, int a, int b);
+static void project(const gpx_point *origin, const gpx_point *pt, double *x, double *y);
+static void let_out(gpx_simplifier *s, const gpx_point *pt);
+
+
+gpx_simplifier *gpx_simplifier_create(const gpx_simplify_options *opts) {
+    if (opts->min_distance < 0 || opts->min_interval < 0 || opts->tolerance < 0
+        || opts->window < 3) {
+        return NULL;
+    }
+
+    gpx_simplifier *s = calloc(1, sizeof(*s));
+    if (s == NULL) return NULL;
+    s->opts = *opts;
+
+    int n = opts->window;
+    s->held = malloc(sizeof(*s->held) * n);
+    s->x = malloc(sizeof(*s->x) * n);
+    s->y = malloc(sizeof(*s->y) * n);
+    s->keep = malloc(n);
+    s->stack = malloc(sizeof(*s->stack) * 2 * n);
+    s->ready = malloc(sizeof(*s->ready) * 2 * n);
+    if (s->held == NULL || s->x == NULL || s->y == NULL || s->keep == NULL
+        || s->stack == NULL || s->ready == NULL) {
+        gpx_simplifier_destroy(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+int gpx_simplifier_add(gpx_simplifier *s, const gpx_point *pt) {
+    if (!pt->has_location) return 0;
+
+    if (s->has_last) {
+        if (s->opts.min_distance > 0) {
+            double x, y;
+            project(&s->last, pt, &x, &y);
+            if (sqrt(x * x + y * y) < s->opts.min_distance) return 0;
+        }
+        if (s->opts.min_interval > 0 && s->last.has_time && pt->has_time
+            && pt->epoch_time - s->last.epoch_time < s->opts.min_interval) {
+            return 0;
+        }
+    }
+    s->last = *pt;
+    s->has_last = 1;
+
+    if (s->opts.tolerance <= 0) {
+        let_out(s, pt);
+        return 1;
+    }
+
+    // the first point of a segment is always kept
+    if (s->num_held == 0) let_out(s, pt);
+
+    s->held[s->num_held++] = *pt;
+    if (s->num_held == s->opts.window) simplify_window(s, 0);
+    return 1;
+}
+
+void gpx_simplifier_flush(gpx_simplifier *s) {
+    if (s->num_held > 1) simplify_window(s, 1);
+    s->num_held = 0;
+    s->has_last = 0;
+}
+
+int gpx_simplifier_next(gpx_simplifier *s, gpx_point *pt) {
+    if (s->first_ready == s->num_ready) return 0;
+
+    *pt = s->ready[s->first_ready++];
+    if (s->first_ready == s->num_ready) s->first_ready = s->num_ready = 0;
+    return 1;
+}
+
+void gpx_simplifier_destroy(gpx_simplifier *s) {
+    if (s == NULL) return;
+
+    free(s->held);
+    free(s->x);
+    free(s->y);
+    free(s->keep);
+    free(s->stack);
+    free(s->ready);
+    free(s);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: runs Douglas-Peucker over the held points and lets out the ones
+// kept.  If final, all of them are let out and the window is emptied;
+// otherwise only those up to the last kept point before the end are,
+// and that point starts the window again with the ones after it.
+static void simplify_window(gpx_simplifier *s, int final) {
+    int n = s->num_held;
+    mark_kept(s);
+
+    int anchor = n - 1;
+    if (!final) {
+        // the end of the window isn't the end of the segment, so the
+        // points after the last kept one inside it are left to decide
+        // with the points still to come
+        int last_kept = n - 2;
+        while (last_kept > 0 && !s->keep[last_kept]) last_kept--;
+        if (last_kept > 0) anchor = last_kept;
+    }
+
+    for (int i = 1; i <= anchor; i++) {
+        if (s->keep[i]) let_out(s, &s->held[i]);
+    }
+
+    for (int i = anchor; i < n; i++) s->held[i - anchor] = s->held[i];
+    s->num_held = n - anchor;
+}
+
+// post: sets keep[i] to 1 for each held point Douglas-Peucker keeps
+// with the tolerance, and 0 for the others
+static void mark_kept(gpx_simplifier *s) {
+    int n = s->num_held;
+
+    for (int i = 0; i < n; i++) {
+        project(&s->held[0], &s->held[i], &s->x[i], &s->y[i]);
+        s->keep[i] = 0;
+    }
+    s->keep[0] = s->keep[n - 1] = 1;
+
+    // split each range at its farthest point until every point is close
+    // enough to the line between the ends of its range
+    int top = 0;
+    s->stack[top++] = 0;
+    s->stack[top++] = n - 1;
+    while (top > 0) {
+        int b = s->stack[--top];
+        int a = s->stack[--top];
+
+        int farthest = -1;
+        double max_distance = s->opts.tolerance;
+        for (int i = a + 1; i < b; i++) {
+            double d = segment_distance(s, i, a, b);
+            if (d > max_distance) {
+                max_distance = d;
+                farthest = i;
+            }
+        }
+
+        if (farthest >= 0) {
+            s->keep[farthest] = 1;
+            s->stack[top++] = a;
+            s->stack[top++] = farthest;
+            s->stack[top++] = farthest;
+            s->stack[top++] = b;
+        }
+    }
+}
+
+// post: returns the distance in meters from held point i to the line
+// segment between held points a and b
+static double segment_distance(const gpx_simplifier *s, int i, int a, int b) {
+    double dx = s->x[b] - s->x[a];
+    double dy = s->y[b] - s->y[a];
+    double px = s->x[i] - s->x[a];
+    double py = s->y[i] - s->y[a];
+
+    double length2 = dx * dx + dy * dy;
+    double t = length2 > 0 ? (px * dx + py * dy) / length2 : 0.0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+
+    double ex = px - t * dx;
+    double ey = py - t * dy;
+    return sqrt(ex * ex + ey * ey);
+}
+
+// post: sets (x, y) to the position in meters of pt east and north of
+// origin, on a plane touching the Earth at origin
+static void project(const gpx_point *origin, const gpx_point *pt, double *x, double *y) {
+    double delta_lon = pt->longitude - origin->longitude;
+    if (delta_lon > 180.0) delta_lon -= 360.0;
+    if (delta_lon < -180.0) delta_lon += 360.0;
+
+    *x = EARTH_RADIUS_M * RADIANS(delta_lon) * cos(RADIANS(origin->latitude));
+    *y = EARTH_RADIUS_M * RADIANS(pt->latitude - origin->latitude);
+}
+
+// post: adds a copy of pt to the end of the ready points
+static void let_out(gpx_simplifier *s, const gpx_point *pt) {
+    s->ready[s->num_ready++] = *pt;
+}
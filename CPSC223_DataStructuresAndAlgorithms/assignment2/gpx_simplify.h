@@ -0,0 +1,90 @@
+#ifndef __GPX_SIMPLIFY_H__
+#define __GPX_SIMPLIFY_H__
+
+#include "gpx_reader.h"
+
+// Streaming downsampling of the points of a track segment.
+//
+// Points go in one at a time and the points kept come out in the same
+// order, so a whole track never has to be held.  Three filters can be
+// combined, applied in this order:
+//
+//   min_distance   drops a point within that many meters of the last
+//                  point kept
+//   min_interval   drops a point less than that many seconds after the
+//                  last point kept (points without a time are kept)
+//   tolerance      Douglas-Peucker: drops points that are within that
+//                  many meters of the line between the points kept on
+//                  either side of them
+//
+// Douglas-Peucker looks at no more than window points at once.  When
+// the window fills, the points kept up to the last one that is sure to
+// stay are let out, and the rest stay in the window.  Every point
+// dropped is still within tolerance of the line between the kept points
+// around it, so the window only costs extra kept points, not error.
+//
+// Distances are taken on a plane touching the Earth at the last point
+// kept, which is exact enough over the few kilometers a window spans.
+// Points without a location are dropped.
+
+#define GPX_SIMPLIFY_DEFAULT_WINDOW (64)
+
+struct gpx_simplify_options {
+    double min_distance;    // meters, 0 for none
+    long min_interval;      // seconds, 0 for none
+    double tolerance;       // meters, 0 for no Douglas-Peucker
+    int window;             // points; at least 3
+};
+
+typedef struct gpx_simplifier gpx_simplifier;
+
+
+/**
+ * Creates a simplifier with the given options.
+ *
+ * @param opts a pointer to the options, non-NULL
+ * @return a pointer to the new simplifier, or NULL if the options are
+ * invalid or allocation fails
+ */
+gpx_simplifier *gpx_simplifier_create(const gpx_simplify_options *opts);
+
+
+/**
+ * Adds the next point of the current segment.  Take any points ready
+ * with gpx_simplifier_next before adding another.
+ *
+ * @param s a pointer to a simplifier, non-NULL
+ * @param pt a pointer to a point, non-NULL
+ * @return 1 if the point was taken, and so may be ready later; 0 if it
+ * was dropped straight away
+ */
+int gpx_simplifier_add(gpx_simplifier *s, const gpx_point *pt);
+
+
+/**
+ * Ends the current segment, making every point still held ready.  The
+ * next point added starts a new segment.
+ *
+ * @param s a pointer to a simplifier, non-NULL
+ */
+void gpx_simplifier_flush(gpx_simplifier *s);
+
+
+/**
+ * Takes the next point that is sure to be kept, if any.
+ *
+ * @param s a pointer to a simplifier, non-NULL
+ * @param pt a pointer to where to copy the point, non-NULL
+ * @return 1 if a point was taken, 0 if none is ready
+ */
+int gpx_simplifier_next(gpx_simplifier *s, gpx_point *pt);
+
+
+/**
+ * Frees the given simplifier.
+ *
+ * @param s a pointer to a simplifier, or NULL
+ */
+void gpx_simplifier_destroy(gpx_simplifier *s);
+
+#endif
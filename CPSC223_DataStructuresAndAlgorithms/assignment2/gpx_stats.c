@@ -0,0 +1,159 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Constant-memory summary statistics of the points of a GPX file
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "location.h"
+#include "gpx_reader.h"
+#include "gpx_pipe.h"
+#include "gpx_stats.h"
+
+static void print_time(const char *name, long seconds, FILE *out);
+static void find_wedge(const gpx_stats *s, double *west, double *east);
+static double degrees_east(double lon);
+
+
+void gpx_stats_init(gpx_stats *s, int spherical) {
+    s->num_points = 0;
+    s->num_located = 0;
+    s->num_timed = 0;
+    s->num_segments = 0;
+    s->min_lat = s->max_lat = 0.0;
+    s->start_time = s->end_time = 0;
+    s->distance = 0.0;
+
+    s->distance_fn = spherical ? location_distance_spherical : location_distance;
+    s->segment_started = 0;
+    for (int i = 0; i < GPX_STATS_LON_BUCKETS; i++) s->buckets[i].west = s->buckets[i].east = HUGE_VAL;
+}
+
+void gpx_stats_add(gpx_stats *s, const gpx_record *rec) {
+    if (rec->kind == GPX_SEGMENT) {
+        s->segment_started = 0;
+        return;
+    }
+    s->num_points++;
+
+    if (rec->has_time) {
+        if (s->num_timed == 0 || rec->epoch_time < s->start_time) s->start_time = rec->epoch_time;
+        if (s->num_timed == 0 || rec->epoch_time > s->end_time) s->end_time = rec->epoch_time;
+        s->num_timed++;
+    }
+
+    location loc = {rec->latitude, rec->longitude};
+    if (!rec->has_location || !location_validate(&loc)) return;
+
+    if (s->num_located == 0) {
+        s->min_lat = s->max_lat = loc.lat;
+    }
+    else {
+        if (loc.lat < s->min_lat) s->min_lat = loc.lat;
+        if (loc.lat > s->max_lat) s->max_lat = loc.lat;
+    }
+    s->num_located++;
+
+    double lon_x = degrees_east(loc.lon);
+    int i = lon_x * GPX_STATS_LON_BUCKETS / 360.0;
+    if (i >= GPX_STATS_LON_BUCKETS) i = GPX_STATS_LON_BUCKETS - 1;
+    gpx_lon_bucket *b = &s->buckets[i];
+    if (b->west == HUGE_VAL) {
+        b->west = b->east = loc.lon;
+    }
+    else {
+        if (lon_x < degrees_east(b->west)) b->west = loc.lon;
+        if (lon_x > degrees_east(b->east)) b->east = loc.lon;
+    }
+
+    if (s->segment_started) {
+        s->distance += s->distance_fn(&s->last, &loc);
+    }
+    else {
+        s->num_segments++;
+        s->segment_started = 1;
+    }
+    s->last = loc;
+}
+
+void gpx_stats_print(const gpx_stats *s, FILE *out) {
+    fprintf(out, "points: %ld\n", s->num_points);
+    fprintf(out, "located: %ld\n", s->num_located);
+    fprintf(out, "segments: %d\n", s->num_segments);
+
+    if (s->num_located > 0) {
+        double west, east;
+        find_wedge(s, &west, &east);
+        fprintf(out, "bbox: %.7f,%.7f,%.7f,%.7f\n", s->min_lat, west, s->max_lat, east);
+    }
+    if (s->num_timed > 0) {
+        print_time("start", s->start_time, out);
+        print_time("end", s->end_time, out);
+        fprintf(out, "duration: %ld\n", s->end_time - s->start_time);
+    }
+    fprintf(out, "distance_km: %.6f\n", s->distance);
+}
+
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+
+// post: prints "name: " and seconds as an ISO 8601 UTC timestamp
+static void print_time(const char *name, long seconds, FILE *out) {
+    time_t t = seconds;
+    struct tm tm;
+    char text[32];
+
+    if (gmtime_r(&t, &tm) == NULL || strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &tm) == 0) {
+        fprintf(out, "%s: %ld\n", name, seconds);
+        return;
+    }
+    fprintf(out, "%s: %s\n", name, text);
+}
+
+// pre: at least one point is located
+// post: sets west and east to the edges of the smallest wedge between
+// two meridians holding every located point, the way track_bounds does:
+// the wedge that wraps around from the westernmost longitude to the
+// easternmost, unless leaving out a wider gap between the buckets gives
+// a smaller one
+static void find_wedge(const gpx_stats *s, double *west, double *east) {
+    int first = 0;
+    while (s->buckets[first].west == HUGE_VAL) first++;
+    int last = GPX_STATS_LON_BUCKETS - 1;
+    while (s->buckets[last].west == HUGE_VAL) last--;
+
+    *west = s->buckets[first].west;
+    *east = s->buckets[last].east;
+    double size = fmod(degrees_east(*east) - degrees_east(*west) + 360, 360);
+
+    int prev = first;
+    for (int i = first + 1; i <= last; i++) {
+        if (s->buckets[i].west == HUGE_VAL) continue;
+
+        // starts at the west of this bucket and wraps around to the east
+        // of the one before
+        double start = s->buckets[i].west;
+        double end = s->buckets[prev].east;
+        double curr_size = fmod(degrees_east(end) - degrees_east(start) + 360, 360);
+        if (curr_size < size) {
+            size = curr_size;
+            *west = start;
+            *east = end;
+        }
+        prev = i;
+    }
+}
+
+// post: returns how many degrees east of longitude 0 lon is, in [0, 360)
+static double degrees_east(double lon) {
+    double x = fmod(lon, 360.0);
+    if (x < 0) x += 360.0;
+    return x >= 360.0 ? x - 360.0 : x;
+}
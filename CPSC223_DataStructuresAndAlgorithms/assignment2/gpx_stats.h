@@ -0,0 +1,87 @@
+#ifndef __GPX_STATS_H__
+#define __GPX_STATS_H__
+
+#include <stdio.h>
+
+#include "location.h"
+#include "gpx_reader.h"
+#include "gpx_pipe.h"
+
+// Summary statistics of a GPX file, gathered one point at a time so a
+// file of any size takes the same memory: how many points and segments,
+// the bounding box, the time span and the total distance.
+//
+// Segments are counted the way gpx_track_read builds a track: only
+// segments with a located point count, and points before the first
+// trkseg tag belong to a segment of their own.  The distance is the sum
+// over each segment of the distances between its consecutive located
+// points, as track_get_lengths would give, with location_distance or,
+// if asked for, the faster location_distance_spherical.
+//
+// The box runs west to east over the smallest wedge between two
+// meridians that holds every point, as track_bounds finds it, so a
+// track across the antimeridian gets a narrow box whose western edge is
+// east of its eastern one.  To keep memory constant the longitudes go
+// into one bucket per degree, keeping only the westernmost and
+// easternmost in each: the wedge is exact whenever the points leave a
+// gap of a degree or more, and otherwise covers all but under two
+// degrees of longitude, to within a degree.
+
+#define GPX_STATS_LON_BUCKETS (360)
+
+// the westernmost and easternmost longitudes in one bucket
+typedef struct {
+    double west;                // HUGE_VAL while empty
+    double east;
+} gpx_lon_bucket;
+
+typedef struct {
+    long num_points;            // trkpts read
+    long num_located;           // those with a location
+    long num_timed;             // those with a time
+    int num_segments;           // segments with a located point
+
+    double min_lat, max_lat;    // over the located points
+    long start_time;            // earliest and latest times, seconds
+    long end_time;              // since the epoch
+    double distance;            // kilometers
+
+    // state between points
+    double (*distance_fn)(const location *, const location *);
+    int segment_started;        // 1 once the current segment has a point
+    location last;              // the last located point of the segment
+    gpx_lon_bucket buckets[GPX_STATS_LON_BUCKETS];  // by degrees east of
+                                                    // longitude 0
+} gpx_stats;
+
+
+/**
+ * Starts the given statistics with no points.
+ *
+ * @param s a pointer to the statistics, non-NULL
+ * @param spherical 1 to measure distance on a sphere, 0 to use the
+ * slower but more exact location_distance
+ */
+void gpx_stats_init(gpx_stats *s, int spherical);
+
+
+/**
+ * Adds the next record: a point of the current segment, or the start
+ * of a new segment (the next located point starts it).
+ *
+ * @param s a pointer to the statistics, non-NULL
+ * @param rec a pointer to a record, non-NULL
+ */
+void gpx_stats_add(gpx_stats *s, const gpx_record *rec);
+
+
+/**
+ * Prints the statistics, one "name: value" line each.  Times are
+ * printed in UTC.
+ *
+ * @param s a pointer to the statistics, non-NULL
+ * @param out the stream to print to, non-NULL
+ */
+void gpx_stats_print(const gpx_stats *s, FILE *out);
+
+#endif
@@ -1,246 +1,1308 @@
-
-
-// to do:
-// make work with stdin
-
 // Jacob Lessing
 // CPSC 223 Fall 2022
 
 // This program parses a GPX File, outputing
 // location, and time data for each trkpt
+//
+// usage: parse_GPX [-threads n | -binary | -binary-e6] [-stream] [filters] [file]
+//        parse_GPX -batch [-threads n] [filters] (directory | list)
+//        parse_GPX [-follow s] [-checkpoint file] [filters] file
+//        parse_GPX -build-index n file
+//        parse_GPX -use-index [-from time] [-to time] [filters] file
+//        parse_GPX -stats [-spherical] [-stream] [filters] [file]
+// filters: [-bbox min_lat,min_lon,max_lat,max_lon] [-from time] [-to time]
+//          [-min-distance m] [-min-interval s] [-simplify m] [-window n]
+// reads stdin when no file (or "-") is given
+// -threads splits a file into chunks parsed by n threads (0 means one
+// per core); the output is the same as the single-threaded output
+// -binary writes a columnar file (see gpx_columns.h) instead of text,
+// with lat/lon as doubles; -binary-e6 stores them as int32 microdegrees
+// -stream reads a file through the prefetching reader thread instead of
+// mapping it, so reading a cold file overlaps with parsing it
+// -batch parses every .gpx file in a directory, or every file named in a
+// list (one path per line, "-" for stdin), on n worker threads (one per
+// core by default).  Each record starts with the path of its file, and
+// the records of a file are never split up.  A file that can't be read
+// is reported and skipped; a summary per worker goes to stderr
+// -bbox keeps only the trkpts inside the box (bounds included), which
+// crosses longitude 180 when min_lon > max_lon; -from and -to keep only
+// those with a time at or after -from and before -to.  A trkpt is
+// dropped as soon as a field fails, without reading the rest
+// -min-distance, -min-interval and -simplify downsample each segment as
+// it is read (see gpx_simplify.h): points closer than m meters or s
+// seconds to the last one kept are dropped, and -simplify drops those
+// Douglas-Peucker finds within m meters of the line, looking at up to
+// -window points at once.  They can't be used with -threads or -batch
+// -checkpoint starts from the offset saved in the given checkpoint file
+// (the start, if there is none) and prints only the trkpts after it,
+// then saves the offset after the last complete trkpt.  -follow keeps
+// doing that every s seconds, printing trkpts as they are appended.  A
+// checkpoint for a different file, or for one that was truncated or
+// rewritten, is ignored
+// -build-index writes file.idx, a seek index with an entry for every nth
+// trkpt (see gpx_seek.h); -use-index then answers -from/-to by reading
+// only the part of the file the index says can hold the window
+// -stats prints the number of points and segments, the bounding box,
+// the time span and the total distance of the trkpts kept, in one pass
+// that holds no more than one point (see gpx_stats.h).  Distances are
+// measured on the oblate spheroid, or on a sphere with -spherical.  The
+// trkpts are parsed on one thread and measured on another (see
+// gpx_pipe.h)
+
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "gpx_input.h"
+#include "gpx_extract.h"
+#include "gpx_reader.h"
+#include "gpx_filter.h"
+#include "gpx_simplify.h"
+#include "gpx_columns.h"
+#include "gpx_seek.h"
+#include "gpx_pipe.h"
+#include "gpx_stats.h"
+
+// chunks are this size unless that would leave threads idle
+#define CHUNK_SIZE (8 << 20)
+#define MIN_CHUNK_SIZE (64 << 10)
+
+// how many chunks past the one being written workers may run ahead
+#define CHUNKS_IN_FLIGHT_PER_THREAD (2)
+
+// a batch worker writes its buffered records once they pass this size
+#define BATCH_FLUSH_SIZE (1 << 20)
+
+// a checkpoint also records a hash of this many bytes before its offset,
+// so that a rewritten file isn't resumed in the wrong place
+#define CHECKPOINT_TAIL (64)
+#define CHECKPOINT_MAGIC "GPXCKPT1"
+
+// the fields printed for each trkpt, in order
+typedef struct {
+    int kind;
+    const char *name;
+} output_field;
+
+static const output_field output_fields[] = {
+    {GPX_ATTRIBUTE, "lat"},
+    {GPX_ATTRIBUTE, "lon"},
+    {GPX_ELEMENT, "ele"},
+    {GPX_ELEMENT, "time"}
+};
+
+#define NUM_OUTPUT_FIELDS ((int) (sizeof(output_fields) / sizeof(output_fields[0])))
+
+// output_fields indexes of the fields the filter tests
+#define LAT_FIELD (0)
+#define LON_FIELD (1)
+#define TIME_FIELD (3)
+
+// the trkpts to keep, set from the command line
+static gpx_filter filter;
+static gpx_simplify_options simplify = {0, 0, 0, GPX_SIMPLIFY_DEFAULT_WINDOW};
+static int simplifying = 0;
+
+// a byte range of the input parsed by one worker thread
+typedef struct {
+    size_t begin;           // trkpts whose tag starts in [begin, end)
+    size_t end;             // belong to this chunk
+
+    // filled in by the worker
+    char *output;
+    size_t output_length;
+    int has_trkpt;          // 0 if no trkpt tag starts in the range
+    size_t first_trkpt;     // offset of the first trkpt tag
+    size_t resume;          // where the scan for the next trkpt begins
+    int ended;              // 1 if the scan for trkpts ended in this chunk
+    int done;
+} chunk;
+
+// state shared by the worker threads and the thread writing output
+typedef struct {
+    const char *data;
+    size_t length;
+    chunk *chunks;
+    int num_chunks;
+    int next_chunk;         // next chunk for a worker to take
+    int written;            // chunks before this one are written
+    int max_in_flight;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} parallel_job;
+
+// the files of a batch, taken in turn by the workers
+typedef struct {
+    char **paths;
+    int num_paths;
+    int next_path;
+    pthread_mutex_t lock;   // guards next_path and stdout
+} batch_job;
+
+// one batch worker thread and its totals
+typedef struct {
+    batch_job *job;
+    pthread_t thread;
+    int num_files;
+    int num_failed;
+    size_t num_bytes;
+    size_t num_points;
+    double seconds;         // time spent on files
+} batch_worker;
+
+// where a follow left off in a file
+typedef struct {
+    unsigned long device;
+    unsigned long inode;
+    size_t offset;          // where the scan for the next trkpt begins
+    uint64_t tail_hash;     // hash of the CHECKPOINT_TAIL bytes before
+} checkpoint;
+
+gpx_extractor *create_extractor(void);
+void print_trkpt(const gpx_extractor *x, FILE *out);
+void print_point(const gpx_point *pt, FILE *out);
+void print_field(const char *value, size_t length, FILE *out);
+int parse_trkpts(gpx_extractor *x, gpx_input *in, FILE *out, size_t limit, size_t *resume);
+int find_trkpt(gpx_extractor *x, gpx_input *in, size_t *found);
+int parse_parallel(gpx_input *in, int num_threads);
+void *parse_worker(void *arg);
+void parse_chunk(const parallel_job *job, chunk *c);
+int parse_binary(gpx_input *in, uint32_t flags);
+int parse_simplified(gpx_input *in);
+int parse_stats(gpx_input *in, int spherical);
+int parse_batch(const char *source, int num_threads);
+void *batch_worker_run(void *arg);
+int parse_batch_file(batch_worker *w, gpx_extractor *x, const char *path, FILE *out);
+void flush_batch_output(batch_job *job, FILE *out, char **buffer);
+void print_batch_summary(const batch_worker *workers, int num_workers, double elapsed);
+char **list_batch_paths(const char *source, int *num_paths);
+char **read_directory(const char *dir_path, int *num_paths);
+char **read_path_list(const char *list_path, int *num_paths);
+int grow_paths(char ***paths, int *capacity);
+void free_paths(char **paths, int count);
+int has_gpx_extension(const char *name);
+int compare_paths(const void *a, const void *b);
+double now_seconds(void);
+int parse_follow(const char *path, const char *checkpoint_path, int interval);
+int parse_new_trkpts(gpx_extractor *x, const char *path, checkpoint *ck);
+int read_checkpoint(const char *checkpoint_path, checkpoint *ck);
+int write_checkpoint(const char *checkpoint_path, const checkpoint *ck);
+uint64_t hash_tail(const gpx_input *in, size_t offset);
+int build_index(const char *path, int every);
+int parse_indexed(const char *path);
+char *index_path(const char *path);
+
+int main(int argc, char **argv)
+{
+    int num_threads = 1;
+    int threads_given = 0;
+    int binary = 0;
+    uint32_t binary_flags = 0;
+    int stream = 0;
+    int batch = 0;
+    int follow_interval = 0;
+    const char *checkpoint_path = NULL;
+    int index_every = 0;
+    int use_index = 0;
+    int stats = 0;
+    int spherical = 0;
+    int usage_error = 0;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0' && !usage_error) {
+        if (arg + 1 < argc && strcmp(argv[arg], "-threads") == 0) {
+            num_threads = atoi(argv[arg + 1]);
+            if (num_threads <= 0) num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+            threads_given = 1;
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "-binary") == 0) {
+            binary = 1;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-binary-e6") == 0) {
+            binary = 1;
+            binary_flags = GPX_COLUMNS_E6;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-stream") == 0) {
+            stream = 1;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-batch") == 0) {
+            batch = 1;
+            arg++;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-bbox") == 0) {
+            usage_error = gpx_filter_set_box(&filter, argv[arg + 1]);
+            arg += 2;
+        }
+        else if (arg + 1 < argc && (strcmp(argv[arg], "-from") == 0 || strcmp(argv[arg], "-to") == 0)) {
+            usage_error = gpx_filter_set_time(&filter, argv[arg + 1], argv[arg][1] == 't');
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-min-distance") == 0) {
+            simplify.min_distance = atof(argv[arg + 1]);
+            simplifying = 1;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-min-interval") == 0) {
+            simplify.min_interval = atol(argv[arg + 1]);
+            simplifying = 1;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-simplify") == 0) {
+            simplify.tolerance = atof(argv[arg + 1]);
+            simplifying = 1;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-window") == 0) {
+            simplify.window = atoi(argv[arg + 1]);
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-follow") == 0) {
+            follow_interval = atoi(argv[arg + 1]);
+            usage_error = follow_interval <= 0;
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-checkpoint") == 0) {
+            checkpoint_path = argv[arg + 1];
+            arg += 2;
+        }
+        else if (arg + 1 < argc && strcmp(argv[arg], "-build-index") == 0) {
+            index_every = atoi(argv[arg + 1]);
+            usage_error = index_every <= 0;
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "-use-index") == 0) {
+            use_index = 1;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-stats") == 0) {
+            stats = 1;
+            arg++;
+        }
+        else if (strcmp(argv[arg], "-spherical") == 0) {
+            spherical = 1;
+            arg++;
+        }
+        else usage_error = 1;
+    }
+
+    if (batch) usage_error = usage_error || binary || stream || argc - arg != 1;
+    if (simplifying) usage_error = usage_error || batch || num_threads > 1;
+    if (follow_interval > 0 || checkpoint_path != NULL) {
+        usage_error = usage_error || batch || binary || stream || simplifying || num_threads > 1
+                      || argc - arg != 1 || strcmp(argv[arg], "-") == 0;
+    }
+    if (index_every > 0) usage_error = usage_error || argc != 4;
+    if (use_index) {
+        usage_error = usage_error || !filter.has_window || batch || binary || stream || simplifying
+                      || num_threads > 1 || follow_interval > 0 || checkpoint_path != NULL
+                      || argc - arg != 1 || strcmp(argv[arg], "-") == 0;
+    }
+    if (stats) {
+        usage_error = usage_error || batch || binary || num_threads > 1 || follow_interval > 0
+                      || checkpoint_path != NULL || index_every > 0 || use_index;
+    }
+    else usage_error = usage_error || spherical;
+    if (simplify.min_distance < 0 || simplify.min_interval < 0 || simplify.tolerance < 0
+        || simplify.window < 3) {
+        usage_error = 1;
+    }
+
+    if (usage_error || argc - arg > 1 || num_threads <= 0 || (binary && num_threads > 1)) {
+        fprintf(stderr, "USAGE: %s [-threads n | -binary | -binary-e6] [-stream] [filters] [file]\n", argv[0]);
+        fprintf(stderr, "       %s -batch [-threads n] [filters] (directory | list)\n", argv[0]);
+        fprintf(stderr, "       %s [-follow s] [-checkpoint file] [filters] file\n", argv[0]);
+        fprintf(stderr, "       %s -build-index n file\n", argv[0]);
+        fprintf(stderr, "       %s -use-index [-from time] [-to time] [filters] file\n", argv[0]);
+        fprintf(stderr, "       %s -stats [-spherical] [-stream] [filters] [file]\n", argv[0]);
+        fprintf(stderr, "filters: [-bbox min_lat,min_lon,max_lat,max_lon] [-from time] [-to time]\n");
+        fprintf(stderr, "         [-min-distance m] [-min-interval s] [-simplify m] [-window n]\n");
+        return 1;
+    }
+
+    if (batch) {
+        if (!threads_given) num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        return parse_batch(argv[arg], num_threads > 0 ? num_threads : 1);
+    }
+
+    if (follow_interval > 0 || checkpoint_path != NULL) {
+        return parse_follow(argv[arg], checkpoint_path, follow_interval);
+    }
+
+    if (index_every > 0) return build_index(argv[arg], index_every);
+    if (use_index) return parse_indexed(argv[arg]);
 
-// how many characters from stdin the program "remembers" as it scans
-// 10 is sufficient as its larger than any attribute or tag name of interest
-#define BUFFER_SIZE 10
+    const char *path = arg < argc ? argv[arg] : NULL;
+    gpx_input *in = stream ? gpx_input_open_stream(path) : gpx_input_open(path);
+    if (in == NULL) return 1;
 
-int scan_for_attribute(char attribute[]);
-int scan_for_start_tag(char element_type[]);
-int print_attribute_value();
-int print_element_text();
+    if (binary) {
+        int result = parse_binary(in, binary_flags);
+        gpx_input_close(in);
+        return result;
+    }
+
+    if (stats) {
+        int result = parse_stats(in, spherical);
+        gpx_input_close(in);
+        return result;
+    }
+
+    if (simplifying) {
+        int result = parse_simplified(in);
+        gpx_input_close(in);
+        return result;
+    }
+
+    // chunks can only be handed out when the whole input is in memory
+    if (num_threads > 1 && gpx_input_is_mapped(in)) {
+        int result = parse_parallel(in, num_threads);
+        gpx_input_close(in);
+        return result;
+    }
+
+    gpx_extractor *x = create_extractor();
+    if (x == NULL) {
+        gpx_input_close(in);
+        return 1;
+    }
 
-int scan_for_string(char target[], int ignore_quotes, int case_insensitive);
+    // will close file and exit program if no more trkpt elements are found
+    size_t resume;
+    parse_trkpts(x, in, stdout, SIZE_MAX, &resume);
+    int failed = in->error;
 
-int main()
-{    
-    // repeatedly scan for additional trkpt elements to parse
+    gpx_extractor_destroy(x);
+    gpx_input_close(in);
+    return failed;
+}
+
+
+// ************************************ //
+//           PARSING FUNCTIONS          //
+// ************************************ //
+
+
+// post: returns an extractor for output_fields, in order, that rejects
+// the trkpts the filter doesn't keep, or NULL if it can't be created
+gpx_extractor *create_extractor(void) {
+    gpx_extractor *x = gpx_extractor_create();
+    if (x == NULL) return NULL;
+
+    for (int i = 0; i < NUM_OUTPUT_FIELDS; i++) {
+        if (gpx_extractor_add_field(x, output_fields[i].kind, output_fields[i].name) != i) {
+            gpx_extractor_destroy(x);
+            return NULL;
+        }
+    }
+    gpx_filter_apply(&filter, x, LAT_FIELD, LON_FIELD, TIME_FIELD);
+    return x;
+}
+
+// post: prints the fields of the trkpt just extracted, separated by
+// commas; commas in the fields are printed as &comma so they can't be
+// confused with field breaks
+void print_trkpt(const gpx_extractor *x, FILE *out) {
+    for (int i = 0; i < NUM_OUTPUT_FIELDS; i++) {
+        size_t length;
+        const char *value = gpx_extractor_value(x, i, &length);
+        print_field(value, length, out);
+
+        putc(i == NUM_OUTPUT_FIELDS - 1 ? '\n' : ',', out);
+    }
+}
+
+// post: prints the fields of a point from a reader the way print_trkpt
+// prints those of an extractor
+void print_point(const gpx_point *pt, FILE *out) {
+    const char *values[] = {pt->lat, pt->lon, pt->ele, pt->time};
+    size_t lengths[] = {pt->lat_length, pt->lon_length, pt->ele_length, pt->time_length};
+
+    for (int i = 0; i < NUM_OUTPUT_FIELDS; i++) {
+        print_field(values[i], lengths[i], out);
+
+        putc(i == NUM_OUTPUT_FIELDS - 1 ? '\n' : ',', out);
+    }
+}
+
+// post: prints the given text with each comma printed as &comma
+void print_field(const char *value, size_t length, FILE *out) {
+    const char *end = value + length;
+
+    const char *comma;
+    while ((comma = memchr(value, ',', end - value)) != NULL) {
+        fwrite(value, 1, comma - value, out);
+        fputs("&comma", out);
+        value = comma + 1;
+    }
+    fwrite(value, 1, end - value, out);
+}
+
+// post: repeatedly scans for additional trkpt elements to parse,
+// stopping before the first one whose tag starts at or after LIMIT
+// returns 0 if stopped at LIMIT; *resume is then the offset where the
+// scan for that trkpt began
+// returns 1 if no more trkpt elements are found
+int parse_trkpts(gpx_extractor *x, gpx_input *in, FILE *out, size_t limit, size_t *resume) {
     while (1) {
-        // will close file and exit program if no more trkpt elements are found
-        if (scan_for_start_tag("<trkpt")) {
+        size_t scan_start = gpx_extractor_offset(x, in);
+
+        size_t found;
+        if (find_trkpt(x, in, &found)) return 1;
+
+        if (found >= limit) {
+            *resume = scan_start;
             return 0;
         }
 
-        // scans, parses, and prints children and fields of trkpt
-        scan_for_attribute(" lat");
-        print_attribute_value();
-        printf(",");
+        if (gpx_extract_point(x, in) != GPX_REJECTED) print_trkpt(x, out);
+    }
+}
+
+// post: reads up to the next trkpt tag, skipping trkseg tags, and sets
+// *found to its offset
+// returns 0 if one is found, 1 at end of input
+int find_trkpt(gpx_extractor *x, gpx_input *in, size_t *found) {
+    int tag;
+    while ((tag = gpx_extract_next_tag(x, in)) == GPX_SEGMENT) continue;
+    if (tag == GPX_END) return 1;
+
+    *found = gpx_extractor_tag_offset(x);
+    return 0;
+}
+
+
+// post: reads every segment and point of the input that the filter
+// keeps, writing them to stdout as a columnar file
+// returns 0 on success, 1 on failure
+int parse_binary(gpx_input *in, uint32_t flags) {
+    gpx_reader *r = gpx_reader_create(in);
+    gpx_columns_writer *w = gpx_columns_create(stdout, flags);
+    if (r == NULL || w == NULL) {
+        fprintf(stderr, "couldn't create columnar output\n");
+        gpx_reader_destroy(r);
+        if (w != NULL) gpx_columns_finish(w);
+        return 1;
+    }
+    gpx_reader_set_filter(r, &filter);
+    if (simplifying && gpx_reader_set_simplify(r, &simplify)) {
+        fprintf(stderr, "couldn't start simplifying\n");
+        gpx_reader_destroy(r);
+        gpx_columns_finish(w);
+        return 1;
+    }
 
-        scan_for_attribute(" lon");
-        print_attribute_value();
-        printf(",");
+    gpx_point pt;
+    int found;
+    while ((found = gpx_read_next(r, &pt)) != GPX_END) {
+        if (found == GPX_SEGMENT) {
+            gpx_columns_start_segment(w);
+            continue;
+        }
+
+        // a point without a readable location can't be stored
+        if (!pt.has_location) continue;
 
-        scan_for_start_tag("<ele");
-        print_element_text();
-        printf(",");
+        float ele = pt.has_elevation ? pt.elevation : NAN;
+        int64_t epoch_time = pt.has_time ? pt.epoch_time : GPX_COLUMNS_NO_TIME;
 
-        scan_for_start_tag("<time");
-        print_element_text();
-        printf("\n");
+        gpx_columns_add_point(w, pt.latitude, pt.longitude, ele, epoch_time);
     }
+    int failed = gpx_reader_failed(r);
+    if (failed) fprintf(stderr, "out of memory simplifying\n");
+    gpx_reader_destroy(r);
+
+    if (gpx_columns_finish(w)) {
+        fprintf(stderr, "error writing columnar output\n");
+        return 1;
+    }
+    return failed;
+}
+
+// post: reads the input through a simplifying reader, printing the
+// points kept to stdout
+// returns 0 on success, 1 on failure
+int parse_simplified(gpx_input *in) {
+    gpx_reader *r = gpx_reader_create(in);
+    if (r == NULL || gpx_reader_set_simplify(r, &simplify)) {
+        fprintf(stderr, "couldn't start simplifying\n");
+        gpx_reader_destroy(r);
+        return 1;
+    }
+    gpx_reader_set_filter(r, &filter);
+
+    gpx_point pt;
+    int found;
+    while ((found = gpx_read_next(r, &pt)) != GPX_END) {
+        if (found == GPX_POINT) print_point(&pt, stdout);
+    }
+
+    int failed = gpx_reader_failed(r);
+    if (failed) fprintf(stderr, "out of memory simplifying\n");
+    gpx_reader_destroy(r);
+    return failed;
+}
+
+// post: reads the trkpts the filters keep on a second thread and
+// prints their statistics
+// returns 0 on success, 1 if reading can't be started or the input
+// can't be read
+int parse_stats(gpx_input *in, int spherical) {
+    gpx_reader *r = gpx_reader_create(in);
+    gpx_pipe *p = gpx_pipe_create(GPX_PIPE_DEFAULT_BATCHES);
+    if (r == NULL || p == NULL || (simplifying && gpx_reader_set_simplify(r, &simplify))) {
+        fprintf(stderr, "couldn't start reading\n");
+        gpx_pipe_destroy(p);
+        gpx_reader_destroy(r);
+        return 1;
+    }
+    gpx_reader_set_filter(r, &filter);
+
+    if (gpx_pipe_start(p, r)) {
+        fprintf(stderr, "couldn't start reading thread\n");
+        gpx_pipe_destroy(p);
+        gpx_reader_destroy(r);
+        return 1;
+    }
+
+    gpx_stats stats;
+    gpx_stats_init(&stats, spherical);
+
+    gpx_record rec;
+    while (gpx_pipe_get(p, &rec)) gpx_stats_add(&stats, &rec);
+
+    gpx_pipe_destroy(p);
+    gpx_reader_destroy(r);
+
+    if (in->error) return 1;
+    gpx_stats_print(&stats, stdout);
+    return 0;
 }
 
 
 // ************************************ //
-//          SCANNING FUNCTIONS          //
+//          PARALLEL FUNCTIONS          //
 // ************************************ //
 
 
-// pre: atribute should be atribute name WITHOUT appended =
-// post: reads stdin stream until TARGET ATRIBUTE is found
-// returns 0 if target is found
-// returns 1 if end of file is reached without match
-int scan_for_attribute(char attribute[]) {
-    int returned_value;
-    char curr_char;
+// pre: in is mapped, num_threads > 1
+// post: parses the input in chunks on num_threads threads, printing the
+// results in input order.  Each chunk after the first guesses where its
+// first trkpt is; the guess is checked against where the single-threaded
+// scan would find it, and a chunk with a wrong guess is parsed again here
+// returns 0 on success, 1 if the threads couldn't be started
+int parse_parallel(gpx_input *in, int num_threads) {
+    gpx_extractor *x = create_extractor();
+    if (x == NULL) return 1;
 
-    // 1: scan for attribute name, but ignore matches inside quotes
-    // 0: make search case sensitive
-    returned_value = scan_for_string(attribute, 1, 0);
+    parallel_job job;
+    job.data = in->base;
+    job.length = in->end - in->base;
 
-    if (returned_value) return 1;   // end of file (EOF)
-    else {
-        if (fscanf(stdin, " %c", &curr_char) <= 0) return 1;    // (EOF)
-        if (curr_char == '=') return 0;                         // target found
-        else scan_for_attribute(attribute);                     // otherwise, search again
+    size_t start = gpx_input_offset(in);
+    size_t chunk_size = CHUNK_SIZE;
+    if ((job.length - start) / num_threads < chunk_size) {
+        chunk_size = (job.length - start) / num_threads + 1;
+    }
+    if (chunk_size < MIN_CHUNK_SIZE) chunk_size = MIN_CHUNK_SIZE;
+
+    job.num_chunks = (job.length - start + chunk_size - 1) / chunk_size;
+    if (job.num_chunks == 0) job.num_chunks = 1;
+    job.chunks = calloc(job.num_chunks, sizeof(*job.chunks));
+    if (job.chunks == NULL) {
+        gpx_extractor_destroy(x);
+        return 1;
+    }
+
+    for (int i = 0; i < job.num_chunks; i++) {
+        job.chunks[i].begin = start + i * chunk_size;
+        job.chunks[i].end = i == job.num_chunks - 1 ? SIZE_MAX : start + (i + 1) * chunk_size;
+    }
+
+    job.next_chunk = 0;
+    job.written = 0;
+    job.max_in_flight = num_threads * CHUNKS_IN_FLIGHT_PER_THREAD;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+
+    pthread_t *threads = malloc(sizeof(*threads) * num_threads);
+    int num_started = 0;
+    while (threads != NULL && num_started < num_threads
+           && pthread_create(&threads[num_started], NULL, parse_worker, &job) == 0) {
+        num_started++;
+    }
+
+    // write chunks in order as they finish
+    int ended = num_started == 0;
+    size_t resume = start;
+    for (int i = 0; i < job.num_chunks && !ended; i++) {
+        chunk *c = &job.chunks[i];
+
+        pthread_mutex_lock(&job.lock);
+        while (!c->done) pthread_cond_wait(&job.changed, &job.lock);
+        pthread_mutex_unlock(&job.lock);
+
+        // does the single-threaded scan, continuing from the end of the
+        // previous chunk, find the same first trkpt as the worker did?
+        int agrees = 1;
+        if (i > 0) {
+            gpx_input_seek(in, resume);
+            gpx_extractor_reset(x);
+
+            size_t found;
+            if (find_trkpt(x, in, &found)) {
+                // the single-threaded scan ends before this chunk's trkpts
+                break;
+            }
+
+            if (found >= c->end) agrees = !c->has_trkpt;
+            else agrees = c->has_trkpt && found == c->first_trkpt;
+        }
+
+        if (agrees && !c->has_trkpt) {
+            // nothing starts here; the next chunk continues from resume
+        }
+        else if (agrees) {
+            fwrite(c->output, 1, c->output_length, stdout);
+            resume = c->resume;
+            ended = ended || c->ended;
+        }
+        else {
+            gpx_input_seek(in, resume);
+            gpx_extractor_reset(x);
+            ended = parse_trkpts(x, in, stdout, c->end, &resume);
+        }
+
+        pthread_mutex_lock(&job.lock);
+        free(c->output);
+        c->output = NULL;
+        job.written = i + 1;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    // stop workers that are still waiting for chunks
+    pthread_mutex_lock(&job.lock);
+    job.written = job.num_chunks;
+    job.next_chunk = job.num_chunks;
+    pthread_cond_broadcast(&job.changed);
+    pthread_mutex_unlock(&job.lock);
+
+    for (int i = 0; i < num_started; i++) pthread_join(threads[i], NULL);
+
+    for (int i = 0; i < job.num_chunks; i++) free(job.chunks[i].output);
+    free(job.chunks);
+    free(threads);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.changed);
+    gpx_extractor_destroy(x);
+
+    return num_started == 0;
+}
+
+// post: takes chunks from the job until there are none left
+void *parse_worker(void *arg) {
+    parallel_job *job = arg;
+
+    pthread_mutex_lock(&job->lock);
+    while (1) {
+        // don't get too far ahead of the chunk being written
+        while (job->next_chunk < job->num_chunks
+               && job->next_chunk >= job->written + job->max_in_flight) {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        if (job->next_chunk >= job->num_chunks) break;
+
+        chunk *c = &job->chunks[job->next_chunk++];
+        pthread_mutex_unlock(&job->lock);
+
+        parse_chunk(job, c);
+
+        pthread_mutex_lock(&job->lock);
+        c->done = 1;
+        pthread_cond_broadcast(&job->changed);
     }
+    pthread_mutex_unlock(&job->lock);
 
-    return 1;
+    return NULL;
 }
 
-// pre: takes element type preceeded by <
-// post: scans stdin stream until desired tag is found
-// returns 0 if target is found
-// returns 1 if end of file is reached without match
-int scan_for_start_tag(char element_type[]) {
-    int returned_value;
-    char curr_char;
+// post: parses the trkpts whose tags start in the given chunk into the
+// chunk's output buffer
+void parse_chunk(const parallel_job *job, chunk *c) {
+    gpx_input *in = gpx_input_from_memory(job->data, job->length);
+    gpx_extractor *x = create_extractor();
+    FILE *out = open_memstream(&c->output, &c->output_length);
+    if (in == NULL || x == NULL || out == NULL) {
+        // leave the chunk for the writing thread to parse
+        c->has_trkpt = 1;
+        c->first_trkpt = SIZE_MAX;
+        if (out != NULL) fclose(out);
+        gpx_extractor_destroy(x);
+        gpx_input_close(in);
+        return;
+    }
 
-    // 1: scan for attribute name, but ignore matches inside quotes
-    // 1: make search case insensitive
-    
-    returned_value = scan_for_string(element_type, 1, 1);
+    gpx_input_seek(in, c->begin);
 
-    // checks that identified attribute name is followed by ' ' or '>'
-    if (returned_value) return 1;   // end of file (EOF)
+    if (c->begin == job->chunks[0].begin) {
+        // the first chunk starts where the single-threaded scan does
+        c->has_trkpt = 1;
+        c->ended = parse_trkpts(x, in, out, c->end, &c->resume);
+    }
     else {
-        if (fscanf(stdin, "%c", &curr_char) <= 0) return 1;   // (EOF)
-        if (curr_char == ' ' || curr_char == '>') {
-            // re-add char to stream so it can be used later
-            if (curr_char == '>') ungetc('>', stdin);
-            if (curr_char == ' ') ungetc(' ', stdin);
-            return 0;                                          // target found
+        // resync: the chunk might start inside a tag or a quoted value,
+        // but a '<' can only start a tag, so begin at the next one
+        const char *lt = memchr(in->pos, '<', in->end - in->pos);
+        if (lt != NULL) gpx_input_seek(in, lt - in->base);
+        else gpx_input_seek(in, job->length);
+
+        c->has_trkpt = !find_trkpt(x, in, &c->first_trkpt) && c->first_trkpt < c->end;
+
+        if (c->has_trkpt) {
+            if (gpx_extract_point(x, in) != GPX_REJECTED) print_trkpt(x, out);
+            c->ended = parse_trkpts(x, in, out, c->end, &c->resume);
         }
-        else scan_for_start_tag(element_type);                 // otherwise, search again
     }
 
-    return 1;
+    fclose(out);
+    gpx_extractor_destroy(x);
+    gpx_input_close(in);
 }
 
 
 // ************************************ //
-//          PRINTING FUNCTIONS          //
+//            BATCH FUNCTIONS           //
 // ************************************ //
 
-// pre: attribute must be first thing in quotes
-// post: prints next attribute value
-// returns 0 if full value is sucessfully printed
-// returns 1 if file ends before closing "/' is encountered
-int print_attribute_value() {
-    char curr_char;
-
-    // value can be enclosed in " or '
-    char enclosing_char;
-
-    // used as a boolean to indicate a state:
-    // 1 indicates stdin is inside an atribute value
-    // 0 indicates stdin is outside any atribute value 
-    int is_inside_value = 0;
-
-    while (fscanf(stdin, "%c", &curr_char) > 0) {
-        switch (is_inside_value) {
-        case 0:
-            // search for start of attribute value
-            if (curr_char == '"' || curr_char == '\'') {
-                is_inside_value = 1;
-                enclosing_char = curr_char;
-            }
+
+// post: parses every file of the batch named by source on num_threads
+// worker threads, writing the records of each file together to stdout
+// returns 0 if every file was parsed, 1 otherwise
+int parse_batch(const char *source, int num_threads) {
+    batch_job job;
+    job.paths = list_batch_paths(source, &job.num_paths);
+    if (job.paths == NULL) return 1;
+    job.next_path = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (num_threads > job.num_paths) num_threads = job.num_paths > 0 ? job.num_paths : 1;
+    batch_worker *workers = calloc(num_threads, sizeof(*workers));
+    if (workers == NULL) {
+        fprintf(stderr, "out of memory\n");
+        free_paths(job.paths, job.num_paths);
+        pthread_mutex_destroy(&job.lock);
+        return 1;
+    }
+
+    double start = now_seconds();
+
+    int num_started = 0;
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].job = &job;
+        if (pthread_create(&workers[i].thread, NULL, batch_worker_run, &workers[i]) != 0) break;
+        num_started++;
+    }
+    // with no threads at all, do the work here
+    if (num_started == 0) {
+        batch_worker_run(&workers[0]);
+        num_started = 1;
+    }
+    else {
+        for (int i = 0; i < num_started; i++) pthread_join(workers[i].thread, NULL);
+    }
+
+    print_batch_summary(workers, num_started, now_seconds() - start);
+
+    int num_failed = 0;
+    for (int i = 0; i < num_started; i++) num_failed += workers[i].num_failed;
+
+    free_paths(job.paths, job.num_paths);
+    free(workers);
+    pthread_mutex_destroy(&job.lock);
+
+    return num_failed > 0;
+}
+
+// post: takes files from the worker's job until there are none left,
+// buffering their records and writing them out in large pieces
+void *batch_worker_run(void *arg) {
+    batch_worker *w = arg;
+    batch_job *job = w->job;
+
+    char *buffer = NULL;
+    size_t buffer_length;
+    FILE *out = open_memstream(&buffer, &buffer_length);
+    gpx_extractor *x = create_extractor();
+    if (out == NULL || x == NULL) {
+        fprintf(stderr, "batch worker couldn't start\n");
+        if (out != NULL) fclose(out);
+        free(buffer);
+        gpx_extractor_destroy(x);
+        return NULL;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&job->lock);
+        int next = job->next_path++;
+        pthread_mutex_unlock(&job->lock);
+        if (next >= job->num_paths) break;
+
+        double start = now_seconds();
+        off_t mark = ftello(out);
+
+        if (parse_batch_file(w, x, job->paths[next], out)) {
+            // drop whatever the failed file added
+            fseeko(out, mark, SEEK_SET);
+            w->num_failed++;
+        }
+        w->num_files++;
+        w->seconds += now_seconds() - start;
+
+        if (ftello(out) >= BATCH_FLUSH_SIZE) flush_batch_output(job, out, &buffer);
+    }
+
+    flush_batch_output(job, out, &buffer);
+    fclose(out);
+    free(buffer);
+    gpx_extractor_destroy(x);
+
+    return NULL;
+}
+
+// post: parses the given file, printing each record prefixed by the
+// path (with commas printed as &comma) to out
+// returns 0 on success, 1 if the file couldn't be read
+int parse_batch_file(batch_worker *w, gpx_extractor *x, const char *path, FILE *out) {
+    gpx_input *in = gpx_input_open(path);
+    if (in == NULL) return 1;
+
+    gpx_extractor_reset(x);
+
+    size_t found;
+    while (!find_trkpt(x, in, &found)) {
+        if (gpx_extract_point(x, in) == GPX_REJECTED) continue;
+
+        for (const char *p = path; *p != '\0'; p++) {
+            if (*p == ',') fputs("&comma", out);
+            else putc(*p, out);
+        }
+        putc(',', out);
+        print_trkpt(x, out);
+        w->num_points++;
+    }
+
+    int failed = in->error;
+    w->num_bytes += gpx_input_offset(in);
+    gpx_input_close(in);
+
+    if (failed) fprintf(stderr, "%s: read failed; skipped\n", path);
+    return failed;
+}
+
+// post: writes what the worker has buffered in out to stdout, in one
+// piece, and empties the buffer
+void flush_batch_output(batch_job *job, FILE *out, char **buffer) {
+    off_t length = ftello(out);
+    fflush(out);
+
+    if (length > 0) {
+        pthread_mutex_lock(&job->lock);
+        fwrite(*buffer, 1, length, stdout);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    fseeko(out, 0, SEEK_SET);
+}
+
+// post: prints the files, bytes, points and throughput of each worker,
+// and of the batch as a whole, to stderr
+void print_batch_summary(const batch_worker *workers, int num_workers, double elapsed) {
+    int total_files = 0, total_failed = 0;
+    size_t total_bytes = 0, total_points = 0;
+
+    fprintf(stderr, "%-8s %8s %8s %10s %12s %9s %9s\n",
+            "worker", "files", "failed", "MB", "points", "seconds", "MB/s");
+    for (int i = 0; i < num_workers; i++) {
+        const batch_worker *w = &workers[i];
+        double mb = w->num_bytes / 1e6;
+        fprintf(stderr, "%-8d %8d %8d %10.1f %12zu %9.3f %9.1f\n", i, w->num_files,
+                w->num_failed, mb, w->num_points, w->seconds,
+                w->seconds > 0 ? mb / w->seconds : 0.0);
+
+        total_files += w->num_files;
+        total_failed += w->num_failed;
+        total_bytes += w->num_bytes;
+        total_points += w->num_points;
+    }
+
+    double mb = total_bytes / 1e6;
+    fprintf(stderr, "%-8s %8d %8d %10.1f %12zu %9.3f %9.1f\n", "total", total_files,
+            total_failed, mb, total_points, elapsed, elapsed > 0 ? mb / elapsed : 0.0);
+}
+
+// post: returns the paths named by source (a directory or a list file),
+// setting *num_paths, or NULL (after printing a message) on failure
+char **list_batch_paths(const char *source, int *num_paths) {
+    struct stat info;
+    if (strcmp(source, "-") != 0 && stat(source, &info) == 0 && S_ISDIR(info.st_mode)) {
+        return read_directory(source, num_paths);
+    }
+    return read_path_list(source, num_paths);
+}
+
+// post: returns the paths of the .gpx files in the given directory, in
+// name order, setting *num_paths
+// returns NULL (after printing a message) if the directory can't be read
+// or the list can't be allocated
+char **read_directory(const char *dir_path, int *num_paths) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        perror(dir_path);
+        return NULL;
+    }
+
+    char **paths = NULL;
+    int count = 0, capacity = 0;
+    int failed = 0;
+    struct dirent *entry;
+    while (!failed && (entry = readdir(dir)) != NULL) {
+        if (!has_gpx_extension(entry->d_name)) continue;
+
+        if (count == capacity && grow_paths(&paths, &capacity)) {
+            failed = 1;
             break;
-        case 1:
-            // print characters until final quote is reached
-            if (curr_char == enclosing_char) return 0;
-            else if (curr_char == ',') printf("&comma");
-            else printf("%c", curr_char);
-            
+        }
+
+        size_t length = strlen(dir_path) + 1 + strlen(entry->d_name) + 1;
+        paths[count] = malloc(length);
+        if (paths[count] == NULL) {
+            failed = 1;
             break;
         }
+        snprintf(paths[count], length, "%s/%s", dir_path, entry->d_name);
+        count++;
     }
+    closedir(dir);
 
-    // end of file reached
-    return 1;
+    if (failed) {
+        fprintf(stderr, "%s: out of memory listing files\n", dir_path);
+        free_paths(paths, count);
+        return NULL;
+    }
 
+    qsort(paths, count, sizeof(*paths), compare_paths);
+    *num_paths = count;
+    return paths != NULL ? paths : malloc(1);
 }
 
-// pre: element has no children & stdin is in start tag of desired element
-// post: prints the element text of the current element
-// returns 0 if full value is sucessfully printed
-// returns 1 if file ends before printing is complete
-int print_element_text() {
-    // >, outside of any string, marks end of start tag
-    if (scan_for_string(">", 1, 0)) return 1;
+// post: returns the paths listed one per line in the given file ("-"
+// for stdin), skipping blank lines, setting *num_paths
+// returns NULL (after printing a message) if the list can't be read or
+// can't be allocated
+char **read_path_list(const char *list_path, int *num_paths) {
+    FILE *list = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+    if (list == NULL) {
+        perror(list_path);
+        return NULL;
+    }
 
-    // print all characters until start of end tag <
-    char curr_char;
-    while (fscanf(stdin, "%c", &curr_char) > 0) {
-        if (curr_char == '<') return 0;
-        else if (curr_char == ',') printf("&comma");
-        else printf("%c", curr_char);
+    char **paths = NULL;
+    int count = 0, capacity = 0;
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    int failed = 0;
+    while ((length = getline(&line, &line_capacity, list)) >= 0) {
+        if (length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+        if (length == 0) continue;
+
+        if (count == capacity && grow_paths(&paths, &capacity)) {
+            failed = 1;
+            break;
+        }
+
+        paths[count] = strdup(line);
+        if (paths[count] == NULL) {
+            failed = 1;
+            break;
+        }
+        count++;
+    }
+    // getline also stops short of the end when it can't read or grow the line
+    if (!feof(list)) failed = 1;
+    free(line);
+    if (list != stdin) fclose(list);
+
+    if (failed) {
+        fprintf(stderr, "%s: couldn't read the list of files\n", list_path);
+        free_paths(paths, count);
+        return NULL;
     }
 
-    // end of file reached without closing ">"
-    return 1;
+    *num_paths = count;
+    return paths != NULL ? paths : malloc(1);
 }
 
+// post: doubles the capacity of the given list of paths (to 64 if it
+// has none)
+// returns 0 on success, 1 if it couldn't grow (it is then left as it was)
+int grow_paths(char ***paths, int *capacity) {
+    int bigger_capacity = *capacity == 0 ? 64 : *capacity * 2;
+    char **bigger = realloc(*paths, sizeof(**paths) * bigger_capacity);
+    if (bigger == NULL) return 1;
 
-// ************************************ //
-//            HELPER FUNCTIONS          //
-// ************************************ //
+    *paths = bigger;
+    *capacity = bigger_capacity;
+    return 0;
+}
 
+// post: frees the given paths and the list holding them
+void free_paths(char **paths, int count) {
+    for (int i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+}
 
-// post: reads stdin stream until TARGET string is found
-// returns 0 if target is found
-// returns 1 if end of file is reached without match
-// ignores characters in quotes when flag ignore_quotes == 1
-// executes case-insensitive search when flag case_insensitive == 1
-int scan_for_string(char target[], int ignore_quotes, int case_insensitive)
-{
-    // stores BUFFER_SIZE most recent characters from input stream
+// post: returns 1 if the file name ends in .gpx (in any case), else 0
+int has_gpx_extension(const char *name) {
+    size_t length = strlen(name);
+    if (length <= 4) return 0;
 
-    // *** I wanted to initialize my buffer like this, but
-    // the code didn't work as a I expected ***
-    //char buffer[BUFFER_SIZE + 1];
-    //buffer[BUFFER_SIZE] = '\0';
-    char buffer[] = "xxxxxxxxxx";
+    const char *extension = name + length - 4;
+    return extension[0] == '.' && tolower((unsigned char) extension[1]) == 'g'
+           && tolower((unsigned char) extension[2]) == 'p'
+           && tolower((unsigned char) extension[3]) == 'x';
+}
 
-    // most recently read char from input
-    char curr_char;
+// post: compares two paths for qsort
+int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
 
-    while (fscanf(stdin, "%c", &curr_char) > 0) {
+// post: returns the time in seconds from an arbitrary fixed point
+double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
 
-        // checks if character is quote, and skips quote if ignore_quotes == 1
-        if (ignore_quotes && (curr_char == '"' || curr_char == '\'')) {
-            // flushes buffer
-            for (size_t i = 0; i < BUFFER_SIZE; i++) {
-                buffer[i] = '`'; // garbage character
-            }
-            
-            // identifies if " or ' started quote
-            char enclosing_char = curr_char;
-
-            // skips characters until corresponding quote,
-            // or end of file is reached
-            while (fscanf(stdin, "%c", &curr_char) > 0) {
-                if (curr_char == enclosing_char) break;
-            }
 
-            // if corresponding quote was found, execution of TARGET search continues
-            if (curr_char == enclosing_char) continue;
+// ************************************ //
+//           FOLLOW FUNCTIONS           //
+// ************************************ //
+
+
+// post: prints the trkpts of the file after the checkpoint (if any),
+// saving the new checkpoint; with an interval, does so again every
+// interval seconds, forever
+// returns 1 on failure (only without an interval), else 0
+int parse_follow(const char *path, const char *checkpoint_path, int interval) {
+    checkpoint ck = {0, 0, 0, 0};
+    if (checkpoint_path != NULL && read_checkpoint(checkpoint_path, &ck)) {
+        fprintf(stderr, "%s: not a checkpoint; starting over\n", checkpoint_path);
+        ck.offset = 0;
+    }
 
-            // otherwise, reached end of file without finding target
-            else return 1;
+    gpx_extractor *x = create_extractor();
+    if (x == NULL) return 1;
+
+    while (1) {
+        int failed = parse_new_trkpts(x, path, &ck);
+        fflush(stdout);
+
+        if (!failed && checkpoint_path != NULL && write_checkpoint(checkpoint_path, &ck)) {
+            fprintf(stderr, "%s: couldn't save checkpoint\n", checkpoint_path);
+            failed = 1;
         }
 
-        // clear space in buffer for new char
-        for (size_t i = 0; i < (BUFFER_SIZE - 1); i++) {
-            buffer[i] = buffer[i + 1];
+        if (interval <= 0) {
+            gpx_extractor_destroy(x);
+            return failed;
         }
+        sleep(interval);
+    }
+}
 
-        // forces character to lowercase if case insensitive is flagged
-        if (case_insensitive) curr_char = tolower(curr_char);
+// post: prints the complete trkpts of the file from the checkpoint's
+// offset on, and moves the checkpoint past them.  A trkpt the file ends
+// inside is left for next time.  If the checkpoint isn't for this file
+// as it now is, starts from the beginning.
+// returns 0 on success, 1 if the file can't be read
+int parse_new_trkpts(gpx_extractor *x, const char *path, checkpoint *ck) {
+    gpx_input *in = gpx_input_open(path);
+    if (in == NULL) return 1;
 
-        // append next input char to buffer
-        buffer[BUFFER_SIZE - 1] = curr_char;
+    struct stat info;
+    if (!gpx_input_is_mapped(in) || fstat(in->fd, &info) < 0) {
+        fprintf(stderr, "%s: can only follow a regular file\n", path);
+        gpx_input_close(in);
+        return 1;
+    }
 
-        // check if buffer contains TARGET
-        if (strstr(buffer, target) != NULL) {
-            // found TARGET
-            return 0;
-        }
+    // only the bytes mapped now are looked at, even if the file grows
+    size_t length = in->end - in->base;
+    if (ck->offset > 0 && (ck->device != (unsigned long) info.st_dev
+                           || ck->inode != (unsigned long) info.st_ino
+                           || ck->offset > length
+                           || ck->tail_hash != hash_tail(in, ck->offset))) {
+        fprintf(stderr, "%s: file changed since checkpoint; starting over\n", path);
+        ck->offset = 0;
+    }
+    ck->device = info.st_dev;
+    ck->inode = info.st_ino;
+
+    gpx_extractor_reset(x);
+    gpx_input_seek(in, ck->offset);
+
+    size_t found;
+    while (!find_trkpt(x, in, &found)) {
+        int result = gpx_extract_point(x, in);
+
+        // a trkpt that runs to the end of what has been written may not
+        // be finished yet
+        if (result == GPX_TRUNCATED || (result == GPX_REJECTED && gpx_input_ensure(in, 1) == 0)) break;
+
+        if (result != GPX_REJECTED) print_trkpt(x, stdout);
+        ck->offset = gpx_extractor_offset(x, in);
     }
 
-    // reached end of file without finding TARGET
-    return 1;
-}
\ No newline at end of file
+    ck->tail_hash = hash_tail(in, ck->offset);
+    gpx_input_close(in);
+    return 0;
+}
+
+// post: reads the checkpoint in the given file into ck; a missing file
+// is the same as a checkpoint at the start
+// returns 0 on success, 1 if the file isn't a checkpoint
+int read_checkpoint(const char *checkpoint_path, checkpoint *ck) {
+    FILE *file = fopen(checkpoint_path, "r");
+    if (file == NULL) return 0;
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    unsigned long long offset, tail_hash;
+    int num_read = fscanf(file, "%8s %lu %lu %llu %llx", magic, &ck->device, &ck->inode,
+                          &offset, &tail_hash);
+    fclose(file);
+
+    if (num_read != 5 || strcmp(magic, CHECKPOINT_MAGIC) != 0) return 1;
+    ck->offset = offset;
+    ck->tail_hash = tail_hash;
+    return 0;
+}
+
+// post: saves ck to the given file, replacing it in one step so that a
+// crash can't leave half a checkpoint
+// returns 0 on success, 1 on failure
+int write_checkpoint(const char *checkpoint_path, const checkpoint *ck) {
+    size_t length = strlen(checkpoint_path) + 5;
+    char *temp_path = malloc(length);
+    if (temp_path == NULL) return 1;
+    snprintf(temp_path, length, "%s.new", checkpoint_path);
+
+    FILE *file = fopen(temp_path, "w");
+    int failed = file == NULL;
+    if (!failed) {
+        fprintf(file, "%s %lu %lu %llu %llx\n", CHECKPOINT_MAGIC, ck->device, ck->inode,
+                (unsigned long long) ck->offset, (unsigned long long) ck->tail_hash);
+        failed = fclose(file) != 0;
+    }
+    if (!failed) failed = rename(temp_path, checkpoint_path) != 0;
+
+    free(temp_path);
+    return failed;
+}
+
+// post: returns the FNV-1a hash of the CHECKPOINT_TAIL bytes (or fewer,
+// near the start) before offset in a mapped input
+uint64_t hash_tail(const gpx_input *in, size_t offset) {
+    size_t start = offset > CHECKPOINT_TAIL ? offset - CHECKPOINT_TAIL : 0;
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = start; i < offset; i++) {
+        hash ^= (unsigned char) in->base[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// ************************************ //
+//            INDEX FUNCTIONS           //
+// ************************************ //
+
+
+// post: writes the seek index of the given file, with an entry for every
+// nth trkpt, next to it
+// returns 0 on success, 1 on failure
+int build_index(const char *path, int every) {
+    char *idx_path = index_path(path);
+    if (idx_path == NULL) return 1;
+
+    int result = gpx_seek_build(path, every, idx_path);
+    free(idx_path);
+    return result;
+}
+
+// post: prints the trkpts of the given file that the filter keeps,
+// reading only the part of the file its index says can hold the
+// filter's time window
+// returns 0 on success, 1 on failure
+int parse_indexed(const char *path) {
+    char *idx_path = index_path(path);
+    if (idx_path == NULL) return 1;
+
+    gpx_seek *idx = gpx_seek_map(idx_path, path);
+    if (idx == NULL) {
+        fprintf(stderr, "%s: missing or out of date; rebuild it with -build-index\n", idx_path);
+        free(idx_path);
+        return 1;
+    }
+    free(idx_path);
+
+    uint64_t begin, end;
+    if (!gpx_seek_find(idx, filter.start_time, filter.end_time, &begin, &end)) {
+        gpx_seek_unmap(idx);
+        return 0;
+    }
+    gpx_seek_unmap(idx);
+
+    gpx_input *in = gpx_input_open(path);
+    gpx_extractor *x = create_extractor();
+    if (in == NULL || x == NULL || !gpx_input_is_mapped(in)) {
+        gpx_extractor_destroy(x);
+        gpx_input_close(in);
+        return 1;
+    }
+
+    // the index was checked against the file's size, so begin is in it
+    gpx_input_seek(in, begin);
+
+    size_t resume;
+    parse_trkpts(x, in, stdout, end, &resume);
+
+    gpx_extractor_destroy(x);
+    gpx_input_close(in);
+    return 0;
+}
+
+// post: returns the name of the index of the given file (the caller
+// frees it), or NULL if allocation fails
+char *index_path(const char *path) {
+    size_t length = strlen(path) + 5;
+    char *idx_path = malloc(length);
+    if (idx_path != NULL) snprintf(idx_path, length, "%s.idx", path);
+    return idx_path;
+}
@@ -0,0 +1,17 @@
+# Included by the makefiles that link gpx_input.o.  Build with ZSTD=1 to
+# read zstd-compressed input as well, and ZSTD_DIR=dir if libzstd isn't
+# where the compiler looks by default (dir/include, dir/lib).  Run make
+# clean when switching, since gpx_input.o is built differently.
+
+comma = ,
+
+ifeq (${ZSTD},1)
+ZSTD_CFLAGS = -DGPX_ZSTD $(if ${ZSTD_DIR},-I${ZSTD_DIR}/include)
+ZSTD_LIBS = $(if ${ZSTD_DIR},-L${ZSTD_DIR}/lib -Wl$(comma)-rpath$(comma)${ZSTD_DIR}/lib) -lzstd
+
+ZSTD_FOUND := $(shell echo 'int main(void) { return ZSTD_versionNumber() == 0; }' \
+	| ${CC} ${ZSTD_CFLAGS} -include zstd.h -x c - -o /dev/null ${ZSTD_LIBS} 2>/dev/null && echo yes)
+ifneq (${ZSTD_FOUND},yes)
+$(error ZSTD=1 needs libzstd and zstd.h; set ZSTD_DIR if they are installed elsewhere)
+endif
+endif
@@ -0,0 +1,60 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Streams the segments and points of a GPX file straight into a track
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "track.h"
+#include "trackpoint.h"
+#include "gpx_input.h"
+#include "gpx_reader.h"
+#include "gpx_simplify.h"
+#include "gpx_pipe.h"
+#include "gpx_track.h"
+
+
+int gpx_track_read(gpx_input *in, track *trk, const gpx_simplify_options *simplify)
+{
+    gpx_record fields;
+    int num_added = 0;
+
+    // the input is parsed on another thread while the track is built
+    // here; one point is reused for every trkpt, since track_add_point
+    // copies it
+    gpx_reader *r = gpx_reader_create(in);
+    gpx_pipe *p = gpx_pipe_create(GPX_PIPE_DEFAULT_BATCHES);
+    trackpoint *pt = trackpoint_create(0.0, 0.0, 0);
+    if (r == NULL || p == NULL || pt == NULL
+        || (simplify != NULL && gpx_reader_set_simplify(r, simplify)) || gpx_pipe_start(p, r)) {
+        gpx_pipe_destroy(p);
+        gpx_reader_destroy(r);
+        if (pt != NULL) trackpoint_destroy(pt);
+        return 0;
+    }
+
+    while (gpx_pipe_get(p, &fields)) {
+        if (fields.kind == GPX_SEGMENT) {
+            // the track starts with an empty segment, so only start
+            // another once the current one has points
+            int last = track_count_segments(trk) - 1;
+            if (track_count_points(trk, last) > 0) track_start_segment(trk);
+            continue;
+        }
+
+        if (!fields.has_location) continue;
+        long time = fields.has_time ? fields.epoch_time : 0;
+
+        if (trackpoint_set(pt, fields.latitude, fields.longitude, time)) {
+            track_add_point(trk, pt);
+            num_added++;
+        }
+    }
+
+    trackpoint_destroy(pt);
+    gpx_pipe_destroy(p);
+    gpx_reader_destroy(r);
+    return num_added;
+}
+
@@ -0,0 +1,26 @@
+#ifndef __GPX_TRACK_H__
+#define __GPX_TRACK_H__
+
+#include "track.h"
+#include "gpx_input.h"
+#include "gpx_simplify.h"
+
+
+/**
+ * Adds the points of the given GPX input to the end of the given track,
+ * without going through parse_GPX's text output.  Each trkseg that
+ * follows points starts a new segment of the track.  Points whose
+ * location is missing or out of range are skipped; a point with a
+ * missing or unreadable time gets time 0.  With simplify options, each
+ * segment is downsampled as it is read, so the points dropped are never
+ * stored.  The input is parsed on a second thread while the track is
+ * built on the calling one.
+ *
+ * @param in a pointer to an input, non-NULL
+ * @param trk a pointer to a valid track
+ * @param simplify a pointer to the downsampling options, or NULL for none
+ * @return the number of points added
+ */
+int gpx_track_read(gpx_input *in, track *trk, const gpx_simplify_options *simplify);
+
+#endif
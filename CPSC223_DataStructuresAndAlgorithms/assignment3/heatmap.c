@@ -1,12 +1,27 @@
+// usage: heatmap [-threads n | -sparse] cell_width cell_height symbols range [gpx_file [min_distance]]
+// reads "lat lon time" lines (blank line between segments) from stdin,
+// or the given GPX file ("-" for GPX on stdin), keeping only points at
+// least min_distance meters from the last one kept if it is given.
+// -threads splits making the map between n threads (0 for one per core).
+// -sparse keeps only the cells with points in memory and prints the map a
+// row at a time from them, for maps too big to hold every cell of
+
+#define _POSIX_C_SOURCE 200809L
+
 #include "track.h"
 #include "trackpoint.h"
+#include "gpx_input.h"
+#include "gpx_track.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 
 char peak(FILE *in);
+void read_text_points(FILE *in, track *trk);
 void int_array2D_destroy(int **arr, int rows);
+void print_row(const int *counts, int cols, const char *symbols, int symbol_range);
 
 int main(int argc, char **argv)
 {
@@ -16,7 +31,32 @@ int main(int argc, char **argv)
     int rows, cols;
     char* symbols;
     int symbol_range;
-    int num_symbols;
+    int num_threads = 1;
+    int sparse = 0;
+    const char *program = argv[0];
+
+    // takes -threads or -sparse off the front, so the rest are where
+    // they always were
+    if (argc > 2 && strcmp(argv[1], "-threads") == 0)
+    {
+        num_threads = atoi(argv[2]);
+        if (num_threads <= 0) num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (num_threads <= 0) num_threads = 1;
+        argc -= 2;
+        argv += 2;
+    }
+    else if (argc > 1 && strcmp(argv[1], "-sparse") == 0)
+    {
+        sparse = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc < 5)
+    {
+        fprintf(stderr, "USAGE: %s [-threads n | -sparse] cell_width cell_height symbols range [gpx_file [min_distance]]\n", program);
+        return 1;
+    }
 
     cell_width = atof(argv[1]);
     cell_height = atof(argv[2]);
@@ -26,31 +66,48 @@ int main(int argc, char **argv)
     // generate track with given trackpoint data
     trk = track_create();
 
-    char c;
-    while ((c = peak(stdin)) != EOF)
+    if (argc > 5)
     {
-        double lat, lon;
-        long time;
-        trackpoint *pt;
+        // GPX goes straight into the track, no parse_GPX text in between
+        gpx_input *in = gpx_input_open(argv[5]);
+        if (in == NULL)
+        {
+            track_destroy(trk);
+            return 1;
+        }
+        gpx_simplify_options simplify = {0, 0, 0, GPX_SIMPLIFY_DEFAULT_WINDOW};
+        if (argc > 6) simplify.min_distance = atof(argv[6]);
+        gpx_track_read(in, trk, argc > 6 ? &simplify : NULL);
+        gpx_input_close(in);
+    }
+    else
+    {
+        read_text_points(stdin, trk);
+    }
 
-        // create new segement, if needed
-        if (c == '\n')
-            track_start_segment(trk);
+    // track_print(trk);
+    // printf("********************\n\n");
 
-        fscanf(stdin, "%lf %lf %ld", &lat, &lon, &time);
-        pt = trackpoint_create(lat, lon, time);
-        track_add_point(trk, pt);
+    if (sparse)
+    {
+        heatmap_sparse *sparse_map = track_heatmap_sparse(trk, cell_width, cell_height);
+        rows = heatmap_sparse_rows(sparse_map);
+        cols = heatmap_sparse_cols(sparse_map);
 
-        // clears '\n' at end of line
-        fgetc(stdin);
+        int *row = malloc(sizeof(int) * (cols > 0 ? cols : 1));
+        for (int i = 0; i < rows; i++)
+        {
+            heatmap_sparse_band(sparse_map, i, 1, row);
+            print_row(row, cols, symbols, symbol_range);
+        }
 
-        trackpoint_destroy(pt);
+        free(row);
+        heatmap_sparse_destroy(sparse_map);
+        track_destroy(trk);
+        return 0;
     }
 
-    // track_print(trk);
-    // printf("********************\n\n");
-
-    track_heatmap(trk, cell_width, cell_height, &map, &rows, &cols);
+    track_heatmap_threads(trk, cell_width, cell_height, num_threads, &map, &rows, &cols);
 
     // testing
     // printf("%d, %d\n", rows, cols);
@@ -65,27 +122,33 @@ int main(int argc, char **argv)
     // }
 
     // printing heatmap
-    num_symbols = strlen(symbols);
-
     for (int i = 0; i < rows; i++)
     {
-        for (int j = 0; j < cols; j++)
-        {
-            char symbol;
-            int which_symbol;
-
-            which_symbol = fmin((map[i][j] / symbol_range), num_symbols - 1);
-            symbol = symbols[which_symbol];
-
-            putchar(symbol);
-        }
-        putchar('\n');
+        print_row(map[i], cols, symbols, symbol_range);
     }
 
     int_array2D_destroy(map, rows);
     track_destroy(trk);
 }
 
+// prints one row of the heatmap, a symbol for each cell
+void print_row(const int *counts, int cols, const char *symbols, int symbol_range)
+{
+    int num_symbols = strlen(symbols);
+
+    for (int j = 0; j < cols; j++)
+    {
+        char symbol;
+        int which_symbol;
+
+        which_symbol = fmin((counts[j] / symbol_range), num_symbols - 1);
+        symbol = symbols[which_symbol];
+
+        putchar(symbol);
+    }
+    putchar('\n');
+}
+
 // peaks at next char in stream.
 // returns EOF if cannot read next char
 char peak(FILE *in)
@@ -94,6 +157,32 @@ char peak(FILE *in)
     return ungetc(c, in);
 }
 
+// reads "lat lon time" lines into trk, starting a new segment
+// at each blank line
+void read_text_points(FILE *in, track *trk)
+{
+    char c;
+    while ((c = peak(in)) != EOF)
+    {
+        double lat, lon;
+        long time;
+        trackpoint *pt;
+
+        // create new segement, if needed
+        if (c == '\n')
+            track_start_segment(trk);
+
+        fscanf(in, "%lf %lf %ld", &lat, &lon, &time);
+        pt = trackpoint_create(lat, lon, time);
+        track_add_point(trk, pt);
+
+        // clears '\n' at end of line
+        fgetc(in);
+
+        trackpoint_destroy(pt);
+    }
+}
+
 // deallocates a 2d array
 void int_array2D_destroy(int **arr, int rows)
 {
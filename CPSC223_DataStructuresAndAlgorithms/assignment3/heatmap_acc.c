@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heatmap_acc.h"
+
+#define ACC_INITIAL_SIZE (16)
+
+struct _heatmap_acc {
+    double cell_width;
+    double cell_height;
+    double north;           // the corner of cell (0, 0)
+    double west;
+    int num_cols;           // columns all the way around
+
+    int* counts;            // alloc_rows by alloc_cols, row by row
+    int first_row;          // the cell counts[0] is for
+    int first_col;
+    int alloc_rows;
+    int alloc_cols;
+
+    int min_row, max_row;   // the cells with points; min_row > max_row while empty
+    int min_col, max_col;
+    long count;
+};
+
+static void acc_regrid(heatmap_acc* acc, int row, int col);
+static void acc_grow(int lo, int hi, int allocated, int need, int limit, int* first, int* size);
+
+// heatmap_acc functions
+
+heatmap_acc* heatmap_acc_create(double cell_width, double cell_height, double north, double west) {
+    heatmap_acc* acc = malloc(sizeof(heatmap_acc));
+
+    acc->cell_width = cell_width;
+    acc->cell_height = cell_height;
+    acc->north = north;
+    acc->west = west;
+    acc->num_cols = ceil(360 / cell_width);
+
+    acc->counts = NULL;
+    acc->first_row = 0;
+    acc->first_col = 0;
+    acc->alloc_rows = 0;
+    acc->alloc_cols = 0;
+
+    acc->min_row = 1;
+    acc->max_row = 0;
+    acc->min_col = 1;
+    acc->max_col = 0;
+    acc->count = 0;
+
+    return acc;
+}
+
+void heatmap_acc_destroy(heatmap_acc* acc) {
+    if (acc == NULL) return;
+    free(acc->counts);
+    free(acc);
+}
+
+void heatmap_acc_add(heatmap_acc* acc, double lat, double lon) {
+    // the same cell track_heatmap would put it in, with the grid's corner
+    // in place of the track's bounds
+    double deg_south_of_north_edge = acc->north - lat;
+    double deg_east_of_west_edge = fmod(lon - acc->west + 360, 360);
+
+    int row = floor(deg_south_of_north_edge / acc->cell_height);
+    int col = floor(deg_east_of_west_edge / acc->cell_width);
+    if (fmod(deg_east_of_west_edge, acc->cell_width) == 0. && col > 0) col--;
+    if (col >= acc->num_cols) col = acc->num_cols - 1;
+
+    if (row < acc->first_row || row >= acc->first_row + acc->alloc_rows
+        || col < acc->first_col || col >= acc->first_col + acc->alloc_cols) {
+        acc_regrid(acc, row, col);
+    }
+
+    acc->counts[(row - acc->first_row) * acc->alloc_cols + (col - acc->first_col)]++;
+
+    if (acc->count == 0) {
+        acc->min_row = acc->max_row = row;
+        acc->min_col = acc->max_col = col;
+    }
+    else {
+        if (row < acc->min_row) acc->min_row = row;
+        if (row > acc->max_row) acc->max_row = row;
+        if (col < acc->min_col) acc->min_col = col;
+        if (col > acc->max_col) acc->max_col = col;
+    }
+    acc->count++;
+}
+
+long heatmap_acc_count(const heatmap_acc* acc) {
+    return acc->count;
+}
+
+void heatmap_acc_get(const heatmap_acc* acc, int*** map, int* rows, int* cols, double* north, double* west) {
+    if (acc->count == 0) {
+        *map = NULL;
+        *rows = 0;
+        *cols = 0;
+        *north = acc->north;
+        *west = acc->west;
+        return;
+    }
+
+    int num_row = acc->max_row - acc->min_row + 1;
+    int num_col = acc->max_col - acc->min_col + 1;
+
+    int** hmap = malloc(sizeof(int*) * num_row);
+    for (int i = 0; i < num_row; i++) {
+        hmap[i] = malloc(sizeof(int) * num_col);
+        const int* from = acc->counts + (acc->min_row + i - acc->first_row) * acc->alloc_cols
+                          + (acc->min_col - acc->first_col);
+        memcpy(hmap[i], from, sizeof(int) * num_col);
+    }
+
+    double corner_west = acc->west + acc->min_col * acc->cell_width;
+    if (corner_west >= 180) corner_west -= 360;
+
+    *map = hmap;
+    *rows = num_row;
+    *cols = num_col;
+    *north = acc->north - acc->min_row * acc->cell_height;
+    *west = corner_west;
+}
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+// post: reallocates the counts so they take in cell (row, col) as well
+// as every cell they did, copying the counts over
+static void acc_regrid(heatmap_acc* acc, int row, int col) {
+    int new_first_row = acc->first_row;
+    int new_rows = acc->alloc_rows;
+    int new_first_col = acc->first_col;
+    int new_cols = acc->alloc_cols;
+
+    if (row < acc->first_row || row >= acc->first_row + acc->alloc_rows) {
+        acc_grow(acc->first_row, acc->first_row + acc->alloc_rows, acc->alloc_rows, row, 0,
+                 &new_first_row, &new_rows);
+    }
+    if (col < acc->first_col || col >= acc->first_col + acc->alloc_cols) {
+        acc_grow(acc->first_col, acc->first_col + acc->alloc_cols, acc->alloc_cols, col, acc->num_cols,
+                 &new_first_col, &new_cols);
+    }
+
+    int* counts = calloc((size_t) new_rows * new_cols, sizeof(int));
+    for (int i = 0; i < acc->alloc_rows; i++) {
+        memcpy(counts + (acc->first_row - new_first_row + i) * new_cols + (acc->first_col - new_first_col),
+               acc->counts + i * acc->alloc_cols, sizeof(int) * acc->alloc_cols);
+    }
+
+    free(acc->counts);
+    acc->counts = counts;
+    acc->first_row = new_first_row;
+    acc->alloc_rows = new_rows;
+    acc->first_col = new_first_col;
+    acc->alloc_cols = new_cols;
+}
+
+// post: sets *first and *size to a range of at least twice the allocated
+// size that covers [lo, hi) and need, extending towards need.  With a
+// positive limit the range is kept within [0, limit)
+static void acc_grow(int lo, int hi, int allocated, int need, int limit, int* first, int* size) {
+    if (allocated == 0) {
+        *size = ACC_INITIAL_SIZE;
+        *first = need - ACC_INITIAL_SIZE / 2;
+    }
+    else {
+        *size = 2 * allocated;
+        if (need < lo) {
+            if (hi - need > *size) *size = hi - need;
+            *first = hi - *size;
+        }
+        else {
+            if (need + 1 - lo > *size) *size = need + 1 - lo;
+            *first = lo;
+        }
+    }
+
+    if (limit > 0) {
+        if (*size > limit) *size = limit;
+        if (*first < 0) *first = 0;
+        if (*first + *size > limit) *first = limit - *size;
+    }
+}
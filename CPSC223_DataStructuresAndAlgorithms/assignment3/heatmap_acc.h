@@ -0,0 +1,78 @@
+#ifndef __HEATMAP_ACC_H__
+#define __HEATMAP_ACC_H__
+
+// A heatmap kept up to date one point at a time.
+//
+// Cells are cell_width degrees of longitude by cell_height degrees of
+// latitude, on a grid fixed by the corner given when it is created, so
+// adding a point never moves the points already counted.  Only the
+// cells around the points added so far are allocated; the allocation
+// doubles in whichever direction a new point falls outside it, so
+// adding a point costs O(1) amortized.  Reading the map costs time in
+// the number of cells, not points.
+
+typedef struct _heatmap_acc heatmap_acc;
+
+
+/**
+ * Creates an empty heatmap.  The cell in row 0 and column 0 has its
+ * north-west corner at the given latitude and longitude.  Rows count
+ * south from there, and columns count east from there, all the way
+ * around to the given longitude again.
+ *
+ * @param cell_width a positive double less than or equal to 360.0
+ * @param cell_height a positive double less than or equal to 180.0
+ * @param north a latitude
+ * @param west a longitude in [-180, 180)
+ * @return a pointer to the new heatmap
+ */
+heatmap_acc* heatmap_acc_create(double cell_width, double cell_height, double north, double west);
+
+
+/**
+ * Destroys the given heatmap.
+ *
+ * @param acc a pointer to a heatmap, or NULL
+ */
+void heatmap_acc_destroy(heatmap_acc* acc);
+
+
+/**
+ * Counts a point at the given location.  A point on the boundary between
+ * two rows is counted in the southern one and a point on the boundary
+ * between two columns in the western one, as in track_heatmap.
+ *
+ * @param acc a pointer to a heatmap, non-NULL
+ * @param lat a latitude
+ * @param lon a longitude
+ */
+void heatmap_acc_add(heatmap_acc* acc, double lat, double lon);
+
+
+/**
+ * Returns the number of points counted in the given heatmap.
+ *
+ * @param acc a pointer to a heatmap, non-NULL
+ */
+long heatmap_acc_count(const heatmap_acc* acc);
+
+
+/**
+ * Copies out the smallest rectangle of cells that holds every point
+ * counted, as a 2-D array with each row separately allocated like
+ * track_heatmap's.  The last four parameters are (simulated) reference
+ * parameters used to return the heatmap, its dimensions, and the
+ * latitude and longitude of its north-west corner.  With no points
+ * counted, the heatmap has no rows or columns.  The caller takes
+ * ownership of the returned array.
+ *
+ * @param acc a pointer to a heatmap, non-NULL
+ * @param map a pointer to a pointer to a 2-D array of ints
+ * @param rows a pointer to an int
+ * @param cols a pointer to an int
+ * @param north a pointer to a double
+ * @param west a pointer to a double
+ */
+void heatmap_acc_get(const heatmap_acc* acc, int*** map, int* rows, int* cols, double* north, double* west);
+
+#endif
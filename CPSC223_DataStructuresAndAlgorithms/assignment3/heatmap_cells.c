@@ -0,0 +1,99 @@
+#include <math.h>
+
+#include "heatmap_cells.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEATMAP_CELLS_AVX2
+#include <immintrin.h>
+#endif
+
+static void heatmap_cells_scalar(const heatmap_grid *g, const double *lat, const double *lon, int n,
+				 int *rows, int *cols);
+#ifdef HEATMAP_CELLS_AVX2
+static int heatmap_cells_avx2(const heatmap_grid *g, const double *lat, const double *lon, int n,
+			      int *rows, int *cols);
+#endif
+
+void heatmap_cells(const heatmap_grid *g, const double *lat, const double *lon, int n, int *rows, int *cols)
+{
+  int done = 0;
+#ifdef HEATMAP_CELLS_AVX2
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+      done = heatmap_cells_avx2(g, lat, lon, n, rows, cols);
+    }
+#endif
+  heatmap_cells_scalar(g, lat + done, lon + done, n - done, rows + done, cols + done);
+}
+
+// one point at a time, the way track_heatmap always has
+static void heatmap_cells_scalar(const heatmap_grid *g, const double *lat, const double *lon, int n,
+				 int *rows, int *cols)
+{
+  for (int i = 0; i < n; i++)
+    {
+      double deg_south_of_north_edge = g->north - lat[i];
+      double deg_east_of_west_edge = fmod(lon[i] - g->west + 360, 360);
+
+      rows[i] = fmin(floor(deg_south_of_north_edge / g->cell_height), g->num_row - 1);
+
+      int col = floor(deg_east_of_west_edge / g->cell_width);
+      if (fmod(deg_east_of_west_edge, g->cell_width) == 0. && col > 0)
+	{
+	  col--;
+	}
+      cols[i] = col;
+    }
+}
+
+#ifdef HEATMAP_CELLS_AVX2
+
+// four points at a time, for all but the last n % 4; returns how many
+// were done.  Every step gives exactly what the scalar code does:
+//
+//  - lon - west + 360 is in [0, 720] for longitudes in [-180, 180], so
+//    the fmod by 360 is subtracting 360 once or twice, which is exact
+//  - the divisions stay divisions, since multiplying by a reciprocal
+//    rounds differently and would move points on cell boundaries
+//  - a point is on a column boundary exactly when fmod gives 0, that is
+//    when d - floor(d / w) * w is 0, which a fused multiply-add gives
+//    without rounding
+//  - the column correction and the clamp to the last row are masks and
+//    a min instead of branches
+__attribute__((target("avx2,fma")))
+static int heatmap_cells_avx2(const heatmap_grid *g, const double *lat, const double *lon, int n,
+			      int *rows, int *cols)
+{
+  const __m256d north = _mm256_set1_pd(g->north);
+  const __m256d west = _mm256_set1_pd(g->west);
+  const __m256d width = _mm256_set1_pd(g->cell_width);
+  const __m256d height = _mm256_set1_pd(g->cell_height);
+  const __m256d last_row = _mm256_set1_pd(g->num_row - 1);
+  const __m256d full_turn = _mm256_set1_pd(360.0);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m256d deg_south = _mm256_sub_pd(north, _mm256_loadu_pd(lat + i));
+      __m256d row = _mm256_floor_pd(_mm256_div_pd(deg_south, height));
+      row = _mm256_min_pd(row, last_row);
+
+      __m256d deg_east = _mm256_add_pd(_mm256_sub_pd(_mm256_loadu_pd(lon + i), west), full_turn);
+      deg_east = _mm256_sub_pd(deg_east, _mm256_and_pd(_mm256_cmp_pd(deg_east, full_turn, _CMP_GE_OQ), full_turn));
+      deg_east = _mm256_sub_pd(deg_east, _mm256_and_pd(_mm256_cmp_pd(deg_east, full_turn, _CMP_GE_OQ), full_turn));
+
+      __m256d col = _mm256_floor_pd(_mm256_div_pd(deg_east, width));
+      __m256d rest = _mm256_fnmadd_pd(col, width, deg_east);
+      __m256d on_boundary = _mm256_and_pd(_mm256_cmp_pd(rest, zero, _CMP_EQ_OQ),
+					  _mm256_cmp_pd(col, zero, _CMP_GT_OQ));
+      col = _mm256_sub_pd(col, _mm256_and_pd(on_boundary, one));
+
+      _mm_storeu_si128((__m128i *)(rows + i), _mm256_cvttpd_epi32(row));
+      _mm_storeu_si128((__m128i *)(cols + i), _mm256_cvttpd_epi32(col));
+    }
+  return i;
+}
+
+#endif
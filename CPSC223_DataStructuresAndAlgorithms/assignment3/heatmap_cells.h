@@ -0,0 +1,33 @@
+#ifndef __HEATMAP_CELLS_H__
+#define __HEATMAP_CELLS_H__
+
+// Finds which cells of a heatmap blocks of points fall in, by the rules
+// of track_heatmap.  On x86 processors with AVX2 and FMA four points are
+// done at once; elsewhere one at a time.  Both give the same cells.
+
+typedef struct
+{
+  double north;         // the north edge of row 0
+  double west;          // the west edge of column 0, in [-180, 180]
+  double cell_width;
+  double cell_height;
+  int num_row;          // points south of the last row are counted in it
+} heatmap_grid;
+
+
+/**
+ * Finds the row and column of the cell each of the given points is in.
+ * A point on the boundary between two rows is in the southern one,
+ * except on the southern edge of the grid, and a point on the boundary
+ * between two columns is in the western one.
+ *
+ * @param g a pointer to a grid, non-NULL
+ * @param lat an array of n latitudes
+ * @param lon an array of n longitudes, each in [-180, 180]
+ * @param n a nonnegative integer
+ * @param rows an array of n ints in which to record the rows
+ * @param cols an array of n ints in which to record the columns
+ */
+void heatmap_cells(const heatmap_grid *g, const double *lat, const double *lon, int n, int *rows, int *cols);
+
+#endif
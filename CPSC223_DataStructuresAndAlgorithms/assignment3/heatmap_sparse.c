@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heatmap_sparse.h"
+
+#define SPARSE_INITIAL_CAPACITY (64)
+#define SPARSE_EMPTY UINT64_MAX
+
+// a cell, keyed by row * cols + col so the keys sort by row then column
+typedef struct {
+    uint64_t key;
+    int count;
+} sparse_entry;
+
+struct _heatmap_sparse {
+    int rows;
+    int cols;
+    sparse_entry* entries;  // a hash table until finished, then the cells in order
+    long capacity;          // slots in the hash table, a power of 2
+    long size;              // cells with points
+    bool finished;
+};
+
+static sparse_entry* sparse_find(sparse_entry* entries, long capacity, uint64_t key);
+static void sparse_embiggen(heatmap_sparse* map);
+static long sparse_lower_bound(const heatmap_sparse* map, uint64_t key);
+static int entry_compare(const void* ele1, const void* ele2);
+
+// heatmap_sparse functions
+
+heatmap_sparse* heatmap_sparse_create(int rows, int cols) {
+    heatmap_sparse* map = malloc(sizeof(heatmap_sparse));
+
+    map->rows = rows;
+    map->cols = cols;
+    map->capacity = SPARSE_INITIAL_CAPACITY;
+    map->entries = malloc(sizeof(sparse_entry) * map->capacity);
+    for (long i = 0; i < map->capacity; i++) map->entries[i].key = SPARSE_EMPTY;
+    map->size = 0;
+    map->finished = false;
+
+    return map;
+}
+
+void heatmap_sparse_destroy(heatmap_sparse* map) {
+    if (map == NULL) return;
+    free(map->entries);
+    free(map);
+}
+
+void heatmap_sparse_add(heatmap_sparse* map, int row, int col, int count) {
+    uint64_t key = (uint64_t) row * map->cols + col;
+    sparse_entry* entry = sparse_find(map->entries, map->capacity, key);
+
+    if (entry->key == SPARSE_EMPTY) {
+        // keeps the table at most half full, so probes stay short
+        if (2 * (map->size + 1) > map->capacity) {
+            sparse_embiggen(map);
+            entry = sparse_find(map->entries, map->capacity, key);
+        }
+        entry->key = key;
+        entry->count = 0;
+        map->size++;
+    }
+    entry->count += count;
+}
+
+void heatmap_sparse_finish(heatmap_sparse* map) {
+    if (map->finished) return;
+
+    // moves the cells to the front of the table, then sorts them
+    long size = 0;
+    for (long i = 0; i < map->capacity; i++) {
+        if (map->entries[i].key != SPARSE_EMPTY) map->entries[size++] = map->entries[i];
+    }
+    qsort(map->entries, size, sizeof(sparse_entry), entry_compare);
+
+    sparse_entry* shrunk = realloc(map->entries, sizeof(sparse_entry) * (size > 0 ? size : 1));
+    if (shrunk != NULL) map->entries = shrunk;
+    map->finished = true;
+}
+
+int heatmap_sparse_rows(const heatmap_sparse* map) {
+    return map->rows;
+}
+
+int heatmap_sparse_cols(const heatmap_sparse* map) {
+    return map->cols;
+}
+
+long heatmap_sparse_count_cells(const heatmap_sparse* map) {
+    return map->size;
+}
+
+void heatmap_sparse_iter_start(heatmap_sparse_iter* it, const heatmap_sparse* map, int first_row) {
+    it->map = map;
+    it->next = sparse_lower_bound(map, (uint64_t) first_row * map->cols);
+}
+
+bool heatmap_sparse_iter_next(heatmap_sparse_iter* it, heatmap_sparse_cell* cell) {
+    const heatmap_sparse* map = it->map;
+    if (it->next >= map->size) return false;
+
+    const sparse_entry* entry = &map->entries[it->next++];
+    cell->row = entry->key / map->cols;
+    cell->col = entry->key % map->cols;
+    cell->count = entry->count;
+    return true;
+}
+
+void heatmap_sparse_band(const heatmap_sparse* map, int first_row, int num_rows, int* band) {
+    memset(band, 0, sizeof(int) * (size_t) num_rows * map->cols);
+
+    uint64_t first_key = (uint64_t) first_row * map->cols;
+    uint64_t end_key = (uint64_t) (first_row + num_rows) * map->cols;
+    for (long i = sparse_lower_bound(map, first_key); i < map->size && map->entries[i].key < end_key; i++) {
+        band[map->entries[i].key - first_key] = map->entries[i].count;
+    }
+}
+
+// ************************************ //
+//            HELPER FUNCTIONS          //
+// ************************************ //
+
+// returns the slot holding key in the given hash table, or the empty
+// slot it would go in
+static sparse_entry* sparse_find(sparse_entry* entries, long capacity, uint64_t key) {
+    // Fibonacci hashing spreads neighbouring cells over the table
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    long i = (hash ^ (hash >> 32)) & (capacity - 1);
+    while (entries[i].key != SPARSE_EMPTY && entries[i].key != key) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &entries[i];
+}
+
+// post: doubles the capacity of the hash table, putting every cell back
+static void sparse_embiggen(heatmap_sparse* map) {
+    long capacity = map->capacity * 2;
+    sparse_entry* entries = malloc(sizeof(sparse_entry) * capacity);
+    for (long i = 0; i < capacity; i++) entries[i].key = SPARSE_EMPTY;
+
+    for (long i = 0; i < map->capacity; i++) {
+        if (map->entries[i].key != SPARSE_EMPTY) {
+            *sparse_find(entries, capacity, map->entries[i].key) = map->entries[i];
+        }
+    }
+
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+}
+
+// returns the index of the first cell of a finished map whose key is at
+// least the given one, or the number of cells if there is none
+static long sparse_lower_bound(const heatmap_sparse* map, uint64_t key) {
+    long lo = 0;
+    long hi = map->size;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (map->entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// orders cells by key
+static int entry_compare(const void* ele1, const void* ele2) {
+    uint64_t key1 = ((const sparse_entry*) ele1)->key;
+    uint64_t key2 = ((const sparse_entry*) ele2)->key;
+    return (key1 > key2) - (key1 < key2);
+}
@@ -0,0 +1,129 @@
+#ifndef __HEATMAP_SPARSE_H__
+#define __HEATMAP_SPARSE_H__
+
+#include <stdbool.h>
+
+// A heatmap that keeps only the cells with points in them, for maps far
+// too big to allocate every cell of, such as a long track in tiny cells.
+//
+// Counts are added to a hash table keyed by the cell's row and column.
+// Once every count is in, heatmap_sparse_finish sorts the cells by row
+// and then column; from then on the map can only be read, either cell by
+// cell with an iterator or a band of rows at a time as a dense array.
+
+typedef struct _heatmap_sparse heatmap_sparse;
+
+// one cell with points in it
+typedef struct {
+    int row;
+    int col;
+    int count;
+} heatmap_sparse_cell;
+
+// walks the cells with points in them, in order of row and then column
+typedef struct {
+    const heatmap_sparse* map;
+    long next;
+} heatmap_sparse_iter;
+
+
+/**
+ * Creates a heatmap with the given dimensions and no points.
+ *
+ * @param rows a nonnegative integer
+ * @param cols a nonnegative integer
+ * @return a pointer to the new heatmap
+ */
+heatmap_sparse* heatmap_sparse_create(int rows, int cols);
+
+
+/**
+ * Destroys the given heatmap.
+ *
+ * @param map a pointer to a heatmap, or NULL
+ */
+void heatmap_sparse_destroy(heatmap_sparse* map);
+
+
+/**
+ * Adds count points to the given cell.  Only valid before
+ * heatmap_sparse_finish.
+ *
+ * @param map a pointer to a heatmap, non-NULL
+ * @param row an integer in [0, rows)
+ * @param col an integer in [0, cols)
+ * @param count a positive integer
+ */
+void heatmap_sparse_add(heatmap_sparse* map, int row, int col, int count);
+
+
+/**
+ * Sorts the cells of the given heatmap for reading.  No more counts can
+ * be added after.
+ *
+ * @param map a pointer to a heatmap, non-NULL
+ */
+void heatmap_sparse_finish(heatmap_sparse* map);
+
+
+/**
+ * Returns the number of rows in the given heatmap.
+ *
+ * @param map a pointer to a heatmap, non-NULL
+ */
+int heatmap_sparse_rows(const heatmap_sparse* map);
+
+
+/**
+ * Returns the number of columns in the given heatmap.
+ *
+ * @param map a pointer to a heatmap, non-NULL
+ */
+int heatmap_sparse_cols(const heatmap_sparse* map);
+
+
+/**
+ * Returns the number of cells with points in them in the given heatmap.
+ *
+ * @param map a pointer to a heatmap, non-NULL
+ */
+long heatmap_sparse_count_cells(const heatmap_sparse* map);
+
+
+/**
+ * Sets up the given iterator to walk the cells with points in them from
+ * the first one in the given row on.
+ *
+ * @param it a pointer to an iterator
+ * @param map a pointer to a finished heatmap
+ * @param first_row an integer in [0, rows]
+ */
+void heatmap_sparse_iter_start(heatmap_sparse_iter* it, const heatmap_sparse* map, int first_row);
+
+
+/**
+ * Moves the given iterator to the next cell with points in it and
+ * copies that cell.
+ *
+ * @param it a pointer to an iterator set up by heatmap_sparse_iter_start
+ * @param cell a pointer to a cell, non-NULL
+ * @return true if there was another cell, false once every one has been
+ * walked
+ */
+bool heatmap_sparse_iter_next(heatmap_sparse_iter* it, heatmap_sparse_cell* cell);
+
+
+/**
+ * Writes the counts of the given band of rows into band, num_rows rows
+ * of cols ints each, one row after another, zero for cells with no
+ * points.  Takes time in the size of the band plus the log of the number
+ * of cells with points.
+ *
+ * @param map a pointer to a finished heatmap
+ * @param first_row an integer in [0, rows)
+ * @param num_rows an integer in [1, rows - first_row]
+ * @param band an array of at least num_rows * cols ints
+ */
+void heatmap_sparse_band(const heatmap_sparse* map, int first_row, int num_rows, int* band);
+
+#endif
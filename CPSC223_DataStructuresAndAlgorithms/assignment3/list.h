@@ -0,0 +1,110 @@
+#ifndef __LIST_H__
+#define __LIST_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct _list list;
+
+
+/**
+ * Creates an empty list that uses the given functions to copy, print,
+ * and destroy its elements.
+ *
+ * @param copy a function that returns a copy of an element
+ * @param print a function that prints an element to a stream
+ * @param destroy a function that destroys an element
+ * @return a pointer to the new list
+ */
+list *list_create(void *(*copy)(const void *), void (*print)(FILE *, const void *), void (*destroy)(void *));
+
+
+/**
+ * Returns the number of elements in the given list.
+ *
+ * @param l a pointer to a list, non-NULL
+ */
+size_t list_size(const list *l);
+
+
+/**
+ * Returns the element at the given index.  The list keeps ownership of it.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param i an index less than the size of the list
+ */
+const void *list_get(const list *l, size_t i);
+
+
+/**
+ * Adds a copy (made with the list's copy function) of the given item to
+ * the end of the list.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param item the item to add
+ */
+void list_add(list *l, const void *item);
+
+
+/**
+ * Adds a copy of the given item at the given index, moving the elements
+ * from that index on back by one.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param item the item to add
+ * @param insertion_index an index no larger than the size of the list
+ */
+void list_add_at_index(list *l, const void *item, int insertion_index);
+
+
+/**
+ * Calls the given function on each element of the list in order, passing
+ * the element, its index, and the given extra argument.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param f a function
+ * @param arg an argument to pass to f
+ */
+void list_for_each(const list *l, void (*f)(const void *elt, size_t i, void *arg), void *arg);
+
+
+/**
+ * Destroys the elements at indices i (inclusive) through j (exclusive)
+ * and removes them from the list.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param i an index
+ * @param j an index no smaller than i and no larger than the size
+ */
+void list_destroy_range(list *l, int i, int j);
+
+
+/**
+ * Sorts the list with a stable mergesort according to the given
+ * comparison function when passed the given extra argument.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param compare a comparison function
+ * @param arg an argument to pass to compare
+ */
+void list_sort(list *l, int (*compare)(const void *, const void *, const void *), const void *arg);
+
+
+/**
+ * Destroys the list and all of its elements.
+ *
+ * @param l a pointer to a list, non-NULL
+ */
+void list_destroy(list *l);
+
+
+/**
+ * Prints the elements of the list, separated by spaces, to the given
+ * stream.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param out a stream
+ */
+void list_print(const list *l, FILE *out);
+
+#endif
@@ -16,18 +16,6 @@
 #define ABSD(x) ((x) >= 0 ? (x) : -(x))
 
 
-/**
- * Returns the distance between the two locations on the Earth's
- * surface, assuming an spherical earth with radius 6371km and
- * flattening 1/298.25.  A return value of NaN indicates an invalid
- * location.
- *
- * @param l1 a valid location
- * @param l2 a valid location
- * @return the distance between those points
- */
-static double location_distance_spherical(const location *l1, const location *l2);
-
 /**
  * Returns the distance between the two locations on the Earth's surface,
  * assuming an oblate spheroid model of earth with semi-major axis 6378.1km
@@ -65,13 +53,14 @@ double location_distance_spherical(const location *l1, const location *l2)
 {
   if (location_validate(l1) && location_validate(l2))
     {
-      double delta_lon = RADIANS(l1->lon - l2->lon);
-      double colat1 = 90.0 - l1->lat;
-      double colat2 = 90.0 - l2->lat;
-      colat1 = RADIANS(colat1);
-      colat2 = RADIANS(colat2);
-      double angle = acos(cos(colat1) * cos(colat2)
-			  + sin(colat1) * sin(colat2) * cos(delta_lon));
+      // haversine rather than the law of cosines, which loses all
+      // precision for points a meter or so apart
+      double sin_half_lat = sin(RADIANS(l2->lat - l1->lat) / 2);
+      double sin_half_lon = sin(RADIANS(l2->lon - l1->lon) / 2);
+      double h = sin_half_lat * sin_half_lat
+	+ cos(RADIANS(l1->lat)) * cos(RADIANS(l2->lat)) * sin_half_lon * sin_half_lon;
+      if (h > 1.0) h = 1.0;
+      double angle = 2 * asin(sqrt(h));
       return EARTH_RADIUS_KM * angle;
     }
   else
@@ -0,0 +1,47 @@
+#ifndef __LOCATION_H__
+#define __LOCATION_H__
+
+#include <stdbool.h>
+
+typedef struct
+{
+  double lat;
+  double lon;
+} location;
+
+
+/**
+ * Determines if the given location is valid.  A valid location
+ * has finite latitude between -90 and 90 (inclusive) and finite
+ * longitude.
+ *
+ * @param l a pointer to a location, or NULL
+ * @return true if and only if the location is non-NULL and valid
+ */
+int location_validate(const location *l);
+
+
+/**
+ * Returns the distance in kilometers between the two locations on the
+ * Earth's surface.  A return value of NaN indicates an invalid location.
+ *
+ * @param l1 a pointer to a valid location
+ * @param l2 a pointer to a valid location
+ * @return the distance between those points
+ */
+double location_distance(const location *l1, const location *l2);
+
+
+/**
+ * Returns the distance in kilometers between the two locations,
+ * assuming a spherical Earth with radius 6371km.  Faster than
+ * location_distance, but off by up to about half a percent.  A return
+ * value of NaN indicates an invalid location.
+ *
+ * @param l1 a pointer to a valid location
+ * @param l2 a pointer to a valid location
+ * @return the distance between those points
+ */
+double location_distance_spherical(const location *l1, const location *l2);
+
+#endif
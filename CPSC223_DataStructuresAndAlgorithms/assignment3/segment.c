@@ -3,56 +3,78 @@
 #include "segment.h"
 #include "list.h"
 
+#define SEG_INITIAL_CAPACITY (8)
+
+// points are kept as parallel arrays rather than a list of separately
+// allocated trackpoints, so a scan over a segment reads memory in order
 struct _segment {
-    list* points;
+    double* lat;
+    double* lon;
+    long* time;
+    int size;
+    int capacity;
     double length;
 };
 
-// points list helper functions
+static int seg_embiggen(segment* seg, int capacity);
+static void seg_append(segment* seg, double lat, double lon, long time);
+
+// points list helper functions, for seg_sort
 void* tp_copy_helper(const void* pt);
 void tp_print_helper(FILE* out, const void* pt);
 void tp_destroy_helper(void* pt);
 
-void seg_merge_helper(const void* pt, size_t index, void* new_seg);
+void seg_copy_back_helper(const void* pt, size_t index, void* seg);
 
 // segment functions
 
 segment* seg_create() {
     segment* seg = malloc(sizeof(segment));
 
-    seg->points = list_create(tp_copy_helper, tp_print_helper, tp_destroy_helper);
+    seg->lat = NULL;
+    seg->lon = NULL;
+    seg->time = NULL;
+    seg->size = 0;
+    seg->capacity = 0;
     seg->length = 0.;
 
     return seg;
 }
 
 void seg_destroy(segment* seg) {
-    list_destroy(seg->points);
+    free(seg->lat);
+    free(seg->lon);
+    free(seg->time);
     free(seg);
 }
 
 int seg_count_points(const segment* seg) {
-    return list_size(seg->points);
+    return seg->size;
 }
 
 void seg_add_point(segment* seg, const trackpoint* pt) {
-    list_add(seg->points, pt);
-
-    // adds new leg to total length distance
-    int num_points = seg_count_points(seg);
-    if (num_points >= 2) {
-        // num_points - 1 is index of last point, so
-        // num_points - 2 is index of second to last point
-        trackpoint* prev = (trackpoint*) list_get(seg->points, num_points - 2);
-        
-        location loc_prev = trackpoint_location(prev);
-        location loc_curr = trackpoint_location(pt);
-        seg->length += location_distance(&loc_prev, &loc_curr);
-    }
+    location loc = trackpoint_location(pt);
+    seg_append(seg, loc.lat, loc.lon, trackpoint_time(pt));
 }
 
 trackpoint* seg_get_point(const segment* seg, int i) {
-    return (trackpoint*) list_get((seg->points), i);
+    return trackpoint_create(seg->lat[i], seg->lon[i], seg->time[i]);
+}
+
+void seg_read_point(const segment* seg, int i, trackpoint* pt) {
+    trackpoint_set(pt, seg->lat[i], seg->lon[i], seg->time[i]);
+}
+
+const double* seg_latitudes(const segment* seg) {
+    return seg->lat;
+}
+
+const double* seg_longitudes(const segment* seg) {
+    return seg->lon;
+}
+
+const long* seg_times(const segment* seg) {
+    return seg->time;
 }
 
 double seg_get_length(const segment* seg) {
@@ -62,26 +84,105 @@ double seg_get_length(const segment* seg) {
 segment* seg_merge(const segment** segs, int num_of_segs) {
     segment* merged = seg_create();
 
+    int total = 0;
+    for (int i = 0; i < num_of_segs; i++) {
+        total += segs[i]->size;
+    }
+    // if this fails, seg_append tries again a point at a time
+    seg_embiggen(merged, total);
+
+    // appending one at a time adds the legs between the segments too
     for (int i = 0; i < num_of_segs; i++) {
-        list_for_each(segs[i]->points, seg_merge_helper, merged);
+        for (int j = 0; j < segs[i]->size; j++) {
+            seg_append(merged, segs[i]->lat[j], segs[i]->lon[j], segs[i]->time[j]);
+        }
     }
 
     return merged;
 }
 
 void seg_sort(segment *seg, int (*compare)(const void *, const void *, const void *), const void *arg) {
-    list_sort(seg->points, compare, arg);
+    // compare takes trackpoints, so sort a list of them and copy the
+    // points back in their new order
+    list* points = list_create(tp_copy_helper, tp_print_helper, tp_destroy_helper);
+    trackpoint* pt = trackpoint_create(0., 0., 0);
+    for (int i = 0; i < seg->size; i++) {
+        seg_read_point(seg, i, pt);
+        list_add(points, pt);
+    }
+    trackpoint_destroy(pt);
+
+    list_sort(points, compare, arg);
+    list_for_each(points, seg_copy_back_helper, seg);
+    list_destroy(points);
 }
 
-// copies given pt from its current segment to the given new segment
-void seg_merge_helper(const void* pt, size_t index, void* new_seg) {
-    seg_add_point((segment*) new_seg, pt);
+// copies given pt into the given segment at the given index
+void seg_copy_back_helper(const void* pt, size_t index, void* seg) {
+    segment* s = (segment*) seg;
+    location loc = trackpoint_location(pt);
+    s->lat[index] = loc.lat;
+    s->lon[index] = loc.lon;
+    s->time[index] = trackpoint_time(pt);
 }
 
 
 void seg_print(FILE* out, const segment* seg) {
     fprintf(stdout, " ");
-    list_print(seg->points, out);
+    trackpoint* pt = trackpoint_create(0., 0., 0);
+    for (int i = 0; i < seg->size; i++) {
+        if (i > 0) fputs(" ", out);
+        seg_read_point(seg, i, pt);
+        tp_print_helper(out, pt);
+    }
+    trackpoint_destroy(pt);
+}
+
+
+// local functions
+
+// makes room for at least capacity points, doubling the arrays so
+// adding points one at a time takes amortized constant time
+// returns 0 on success, 1 if there isn't memory for them
+static int seg_embiggen(segment* seg, int capacity) {
+    if (capacity <= seg->capacity) return 0;
+
+    int new_capacity = seg->capacity > 0 ? seg->capacity : SEG_INITIAL_CAPACITY;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+
+    // an array that can't grow is kept as it was; any that did grow are
+    // just bigger than they need to be until the next try
+    double* bigger_lat = realloc(seg->lat, sizeof(*seg->lat) * new_capacity);
+    if (bigger_lat != NULL) seg->lat = bigger_lat;
+    double* bigger_lon = realloc(seg->lon, sizeof(*seg->lon) * new_capacity);
+    if (bigger_lon != NULL) seg->lon = bigger_lon;
+    long* bigger_time = realloc(seg->time, sizeof(*seg->time) * new_capacity);
+    if (bigger_time != NULL) seg->time = bigger_time;
+    if (bigger_lat == NULL || bigger_lon == NULL || bigger_time == NULL) return 1;
+
+    seg->capacity = new_capacity;
+    return 0;
+}
+
+// adds the given point to the end of the segment, unless there isn't
+// memory for it
+static void seg_append(segment* seg, double lat, double lon, long time) {
+    if (seg_embiggen(seg, seg->size + 1)) return;
+
+    int i = seg->size;
+    seg->lat[i] = lat;
+    seg->lon[i] = lon;
+    seg->time[i] = time;
+    seg->size++;
+
+    // adds new leg to total length distance
+    if (i >= 1) {
+        location loc_prev = {seg->lat[i - 1], seg->lon[i - 1]};
+        location loc_curr = {lat, lon};
+        seg->length += location_distance(&loc_prev, &loc_curr);
+    }
 }
 
 
@@ -102,4 +203,3 @@ void tp_print_helper(FILE* out, const void* pt) {
 void tp_destroy_helper(void* pt) {
     trackpoint_destroy((trackpoint*) pt);
 }
-
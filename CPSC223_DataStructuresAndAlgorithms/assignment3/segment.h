@@ -0,0 +1,117 @@
+#ifndef __SEGMENT_H__
+#define __SEGMENT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trackpoint.h"
+
+typedef struct _segment segment;
+
+
+/**
+ * Creates an empty segment.
+ *
+ * @return a pointer to the new segment
+ */
+segment *seg_create();
+
+
+/**
+ * Destroys the given segment and its points.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ */
+void seg_destroy(segment *seg);
+
+
+/**
+ * Returns the number of points in the given segment.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ */
+int seg_count_points(const segment *seg);
+
+
+/**
+ * Adds a copy of the given point to the end of the given segment.  If
+ * there isn't memory for it the segment is left as it was.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ * @param pt a pointer to a track point, non-NULL
+ */
+void seg_add_point(segment *seg, const trackpoint *pt);
+
+
+/**
+ * Returns a copy of the point at the given index.  The caller takes
+ * ownership of it.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ * @param i an index less than the number of points in the segment
+ */
+trackpoint *seg_get_point(const segment *seg, int i);
+
+
+/**
+ * Copies the point at the given index into the given track point, for
+ * reading many points without allocating one each.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ * @param i an index less than the number of points in the segment
+ * @param pt a pointer to the track point to overwrite, non-NULL
+ */
+void seg_read_point(const segment *seg, int i, trackpoint *pt);
+
+
+/**
+ * Returns the latitudes of the points of the given segment, in order,
+ * for scanning every point without copying them.  The segment keeps
+ * ownership of the array, which is only valid until the segment is changed.
+ * seg_longitudes and seg_times are the same for longitudes and times.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ */
+const double *seg_latitudes(const segment *seg);
+const double *seg_longitudes(const segment *seg);
+const long *seg_times(const segment *seg);
+
+
+/**
+ * Returns the total length in kilometers of the legs of the given segment.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ */
+double seg_get_length(const segment *seg);
+
+
+/**
+ * Returns a new segment made of copies of the points of the given
+ * segments, in order.  The caller takes ownership of the new segment.
+ *
+ * @param segs an array of pointers to segments
+ * @param num_of_segs the number of segments in that array
+ */
+segment *seg_merge(const segment **segs, int num_of_segs);
+
+
+/**
+ * Sorts the points of the given segment according to the given
+ * comparison function when passed the given extra argument.
+ *
+ * @param seg a pointer to a segment, non-NULL
+ * @param compare a comparison function on track points
+ * @param arg an argument to pass to compare
+ */
+void seg_sort(segment *seg, int (*compare)(const void *, const void *, const void *), const void *arg);
+
+
+/**
+ * Prints the points of the given segment to the given stream.
+ *
+ * @param out a stream
+ * @param seg a pointer to a segment, non-NULL
+ */
+void seg_print(FILE *out, const segment *seg);
+
+#endif
@@ -1,12 +1,17 @@
 #include <math.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "track.h"
+#include "heatmap_acc.h"
+#include "heatmap_cells.h"
+#include "heatmap_sparse.h"
 #include "segment.h"
 #include "list.h"
 
 struct track
 {
     list *segments;
+    heatmap_acc *heatmap; // kept up to date as points are added, or NULL
     // int num_of_segments;
 };
 
@@ -18,8 +23,82 @@ void seg_print_helper(FILE *out, const void *seg);
 void seg_destroy_helper(void *seg);
 
 void get_lengths_helper(const void *seg, size_t index, void *lengths);
-int pt_compare(const void *ele1, const void *ele2, const void *arg);
-static void track_bounds(const track *trk, double *west, double *east, double *north, double *south);
+
+// track_bounds works in shares of at least this many points per thread
+#define BOUNDS_POINTS_PER_THREAD (1 << 18)
+
+// the westernmost and easternmost longitudes put in one bucket
+typedef struct
+{
+    double west; // HUGE_VAL while empty
+    double east;
+} lon_bucket;
+
+// one thread's share of the work of track_bounds
+typedef struct
+{
+    const track_span *spans;
+    int num_segs;
+    lon_bucket *buckets;
+    int num_buckets;
+    bool shared; // whether other threads fill the buckets too
+
+    long first_pt, end_pt;        // points [first_pt, end_pt) of the whole track
+    int first_bucket, end_bucket; // buckets [first_bucket, end_bucket)
+
+    double min_lat, max_lat;
+    int first_used, last_used; // non-empty buckets in the share, -1 if none
+    double min_sector_size, min_sector_start, min_sector_end;
+} bounds_worker;
+
+// track_heatmap works in shares of at least this many points per thread
+#define HEATMAP_POINTS_PER_THREAD (1 << 18)
+
+// how many points track_heatmap finds the cells of at once
+#define HEATMAP_BLOCK (256)
+
+// points in a row in the same cell
+typedef struct
+{
+    int row, col;
+    int count;
+} heatmap_run;
+
+// one thread's share of the work of track_heatmap
+typedef struct heatmap_worker
+{
+    const track_span *spans;
+    int num_segs;
+    long first_pt, end_pt; // points [first_pt, end_pt) of the whole track
+
+    double north, west;
+    double cell_width, cell_height;
+    int num_row, num_col;
+
+    int **counts; // this share's counts; the map itself for the first worker, or every one by band
+    struct heatmap_worker *all;
+    int num_workers;
+    int first_row, end_row; // rows [first_row, end_row) to add up
+
+    // for maps too big for one per thread: the runs in the share, band
+    // by band, where the runs in band b are [band_start[b], band_start[b + 1])
+    bool by_band;
+    heatmap_run *runs;
+    long *band_start;
+} heatmap_worker;
+
+static track_span span_part(track_span span, long seg_start, long first_pt, long end_pt);
+static void run_workers(void *workers, size_t worker_size, int num_workers, void *(*phase)(void *));
+static void *heatmap_count(void *arg);
+static void *heatmap_add_up(void *arg);
+static void heatmap_sort_runs(heatmap_worker *w, const heatmap_run *found, long num_runs);
+static int heatmap_band(const heatmap_worker *w, int row);
+static void *heatmap_add_runs(void *arg);
+static double lon_east(double lon);
+static void *bounds_clear(void *arg);
+static void *bounds_fill(void *arg);
+static void bucket_add(lon_bucket *b, double lon, double lon_x, bool shared);
+static void *bounds_scan(void *arg);
 
 // track functions
 
@@ -29,6 +108,7 @@ track *track_create()
 
     trk->segments = list_create(seg_copy_helper, seg_print_helper, seg_destroy_helper);
     list_add(trk->segments, seg_create());
+    trk->heatmap = NULL;
 
     // trk->num_of_segments = 1;
 
@@ -38,6 +118,7 @@ track *track_create()
 void track_destroy(track *trk)
 {
     list_destroy(trk->segments);
+    heatmap_acc_destroy(trk->heatmap);
     free(trk);
 }
 
@@ -56,7 +137,50 @@ int track_count_points(const track *trk, int i)
 // caller takes ownership of the returned track point
 trackpoint *track_get_point(const track *trk, int i, int j)
 {
-    return trackpoint_copy(seg_get_point(track_get_seg(trk, i), j));
+    return seg_get_point(track_get_seg(trk, i), j);
+}
+
+// returned arrays are owned by the segment
+track_span track_get_span(const track *trk, int i)
+{
+    const segment *seg = track_get_seg(trk, i);
+
+    track_span span;
+    span.lat = seg_latitudes(seg);
+    span.lon = seg_longitudes(seg);
+    span.time = seg_times(seg);
+    span.count = seg_count_points(seg);
+    return span;
+}
+
+void track_cursor_start(track_cursor *c, const track *trk)
+{
+    c->trk = trk;
+    c->seg = 0;
+    c->next = 0;
+    c->span = track_get_span(trk, 0);
+}
+
+bool track_cursor_next(track_cursor *c, location *loc, long *time)
+{
+    // move on to the next segment with points once this one is used up
+    while (c->next == c->span.count)
+    {
+        if (c->seg + 1 >= track_count_segments(c->trk))
+            return false;
+
+        c->seg++;
+        c->next = 0;
+        c->span = track_get_span(c->trk, c->seg);
+    }
+
+    loc->lat = c->span.lat[c->next];
+    loc->lon = c->span.lon[c->next];
+    if (time != NULL)
+        *time = c->span.time[c->next];
+
+    c->next++;
+    return true;
 }
 
 // Caller takes ownership of returned array
@@ -73,6 +197,12 @@ void track_add_point(track *trk, const trackpoint *pt)
     segment *last_seg = track_get_seg(trk, track_count_segments(trk) - 1);
     // seg_add_point makes copy
     seg_add_point(last_seg, pt);
+
+    if (trk->heatmap != NULL)
+    {
+        location loc = trackpoint_location(pt);
+        heatmap_acc_add(trk->heatmap, loc.lat, loc.lon);
+    }
 }
 
 void track_start_segment(track *trk)
@@ -111,14 +241,49 @@ void track_merge_segments(track *trk, int start, int end)
     free(segs_to_merge);
 }
 
-// NEED TO FINISH
+// counts the points already in the track now; track_add_point
+// counts the rest as they come
+void track_attach_heatmap(track *trk, double cell_width, double cell_height, double north, double west)
+{
+    heatmap_acc_destroy(trk->heatmap);
+    trk->heatmap = heatmap_acc_create(cell_width, cell_height, north, west);
+
+    track_cursor c;
+    location loc;
+    track_cursor_start(&c, trk);
+    while (track_cursor_next(&c, &loc, NULL))
+    {
+        heatmap_acc_add(trk->heatmap, loc.lat, loc.lon);
+    }
+}
+
+// track retains ownership
+const heatmap_acc *track_get_heatmap(const track *trk)
+{
+    return trk->heatmap;
+}
+
 void track_heatmap(const track *trk, double cell_width, double cell_height,
                    int ***map, int *rows, int *cols)
+{
+    track_heatmap_threads(trk, cell_width, cell_height, 1, map, rows, cols);
+}
+
+// for small maps each thread counts its share of the points in a map of
+// its own, then each adds up a band of rows of all those maps into the
+// first one.  Maps bigger than a thread's share of the points would cost
+// more to allocate and add up than to count, so there each thread sorts
+// the cells of its share by band of rows instead, and then each counts
+// every thread's cells in its own band straight into the one map.
+// Counting is the same integer increments whatever the split, so the
+// result is the same as with one thread
+void track_heatmap_threads(const track *trk, double cell_width, double cell_height, int num_threads,
+                           int ***map, int *rows, int *cols)
 {
     double west, east, north, south;
     int num_row, num_col;
     
-    track_bounds(trk, &west, &east, &north, &south);
+    track_bounds(trk, num_threads, &west, &east, &north, &south);
     // printf("bounds: W: %lf E: %lf N: %lf S: %lf\n", west, east, north, south);
 
     num_row = ceil((north - south) / cell_height);
@@ -131,35 +296,67 @@ void track_heatmap(const track *trk, double cell_width, double cell_height,
         int* curr_row = calloc(num_col, sizeof(int));
         hmap[i] = curr_row;
     }
-    
-
 
-    // iterate through all trackpoints
-    // increment the cell in hmap corresponding the the location of the trackpoint
     int num_segs = track_count_segments(trk);
+    track_span *spans = malloc(sizeof(track_span) * num_segs);
+    long num_pts = 0;
     for (int curr_seg = 0; curr_seg < num_segs; curr_seg++) {
-        int num_pts = track_count_points(trk, curr_seg);
-
-        for (int curr_pt = 0; curr_pt < num_pts; curr_pt++) {
-            trackpoint *pt = track_get_point(trk, curr_seg, curr_pt);
-            location loc = trackpoint_location(pt);
-
-            double deg_south_of_north_edge = north - loc.lat;
-            double deg_east_of_west_edge = fmod(loc.lon - west + 360, 360);
-            
-            int hmap_row = fmin(floor(deg_south_of_north_edge / cell_height), num_row - 1);
+        spans[curr_seg] = track_get_span(trk, curr_seg);
+        num_pts += spans[curr_seg].count;
+    }
 
+    // a map per thread only pays while it is smaller than the thread's
+    // share of the points
+    long num_cells = (long)num_row * num_col;
+    if (num_threads > num_pts / HEATMAP_POINTS_PER_THREAD)
+        num_threads = num_pts / HEATMAP_POINTS_PER_THREAD;
+    if (num_threads < 1)
+        num_threads = 1;
+    bool by_band = num_threads > 1 && num_cells > num_pts / num_threads;
+
+    heatmap_worker *workers = malloc(sizeof(heatmap_worker) * num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        heatmap_worker *w = &workers[i];
+        w->spans = spans;
+        w->num_segs = num_segs;
+        w->first_pt = num_pts * i / num_threads;
+        w->end_pt = num_pts * (i + 1) / num_threads;
+        w->north = north;
+        w->west = west;
+        w->cell_width = cell_width;
+        w->cell_height = cell_height;
+        w->num_row = num_row;
+        w->num_col = num_col;
+        w->counts = i == 0 || by_band ? hmap : NULL;
+        w->all = workers;
+        w->num_workers = num_threads;
+        w->first_row = (long)num_row * i / num_threads;
+        w->end_row = (long)num_row * (i + 1) / num_threads;
+        w->by_band = by_band;
+        w->runs = NULL;
+        w->band_start = NULL;
+    }
 
-            int hmap_col = floor(deg_east_of_west_edge / cell_width);
-            if (fmod(deg_east_of_west_edge, cell_width) == 0. && (hmap_col > 0)) hmap_col--;
-            
-            // printf("(%lf, %lf) -> (%d, %d)\n", loc.lat, loc.lon, hmap_row, hmap_col);
-            
-            hmap[hmap_row][hmap_col]++;
+    run_workers(workers, sizeof(heatmap_worker), num_threads, heatmap_count);
+    if (by_band) {
+        run_workers(workers, sizeof(heatmap_worker), num_threads, heatmap_add_runs);
+    }
+    else if (num_threads > 1) {
+        run_workers(workers, sizeof(heatmap_worker), num_threads, heatmap_add_up);
+    }
 
-            free(pt);
+    for (int i = 0; i < num_threads; i++) {
+        if (by_band) {
+            free(workers[i].runs);
+            free(workers[i].band_start);
+        }
+        else if (i > 0) {
+            free(workers[i].counts[0]);
+            free(workers[i].counts);
         }
     }
+    free(workers);
+    free(spans);
 
     *rows = num_row;
     *cols = num_col;
@@ -168,181 +365,472 @@ void track_heatmap(const track *trk, double cell_width, double cell_height,
     return;
 }
 
-// LOCAL FUNCTIONS
-
-/**
- * Determines: 1) the latitude of the northernmost and southernmost track points in the given track; and 2)
- * the meridian of longitude at the western edge of the smallest spherical wedge bounded by two meridians
- * that contains all the points in the track (the "western edge" for a nontrivial wedge being the one that,
- * when you move east from it along the equator, you stay in the wedge).  When there are multiple such wedges,
- * this function finds the one with the lowest normalized (adjusted to the range -180 (inclusive)
- * to 180 (exclusive)) longitude.
- *
- * @param trk a pointer to a valid, non-empty track
- * @param west a pointer to a double in which to record the western edge of the containing wedge
- * @param east a pointer to a double in which to record the eastern edge of the containing wedge
- * @param north a pointer to a double in which to record the latitude of the northernmost point
- * @param south a pointer to a double in which to record the latitude of the southernmost point
- */
-static void track_bounds(const track *trk, double *west, double *east, double *north, double *south)
+// the cells are found a block at a time, as in track_heatmap, and only
+// the ones with points get a count
+heatmap_sparse *track_heatmap_sparse(const track *trk, double cell_width, double cell_height)
 {
-    double min_lat, max_lat;
-    double min_sector_size;
-    double min_sector_start, min_sector_end;
-    int num_pts;
+    double west, east, north, south;
+    track_bounds(trk, 1, &west, &east, &north, &south);
+
+    int num_row = ceil((north - south) / cell_height);
+    int num_col = ceil(fmod((east - west + 360), 360) / cell_width);
+    heatmap_sparse *map = heatmap_sparse_create(num_row, num_col);
 
-        // copies every trackpoint in trk to new segment, pts.
-    segment *pts = seg_create();
+    heatmap_grid grid = {north, west, cell_width, cell_height, num_row};
+    int block_rows[HEATMAP_BLOCK];
+    int block_cols[HEATMAP_BLOCK];
 
     int num_segs = track_count_segments(trk);
     for (int curr_seg = 0; curr_seg < num_segs; curr_seg++)
     {
-        int num_pts = track_count_points(trk, curr_seg);
+        track_span span = track_get_span(trk, curr_seg);
 
-        for (int curr_pt = 0; curr_pt < num_pts; curr_pt++)
+        for (int first = 0; first < span.count; first += HEATMAP_BLOCK)
         {
-            trackpoint *pt = track_get_point(trk, curr_seg, curr_pt);
-            seg_add_point(pts, pt);
-            free(pt);
+            int n = span.count - first < HEATMAP_BLOCK ? span.count - first : HEATMAP_BLOCK;
+            heatmap_cells(&grid, span.lat + first, span.lon + first, n, block_rows, block_cols);
+
+            // a run of points in the same cell is one lookup
+            int run = 1;
+            for (int i = 1; i <= n; i++)
+            {
+                if (i < n && block_rows[i] == block_rows[i - 1] && block_cols[i] == block_cols[i - 1])
+                {
+                    run++;
+                }
+                else
+                {
+                    heatmap_sparse_add(map, block_rows[i - 1], block_cols[i - 1], run);
+                    run = 1;
+                }
+            }
         }
     }
 
-    // **********************************************************************
-    // identifies max and min latitudes
-    // **********************************************************************
-
-    min_lat = 90.0; // lat can range from -90 to 90
-    max_lat = -90.0;
+    heatmap_sparse_finish(map);
+    return map;
+}
 
-    num_pts = seg_count_points(pts);
-    for (int i = 0; i < num_pts; i++)
+// finds the bounds in linear time: the longitudes go into num_pts + 1
+// buckets by how far east of longitude 0 they are, and only the
+// westernmost and easternmost longitude in each bucket is kept.  With
+// more buckets than longitudes the widest gap between longitudes is
+// wider than a bucket, so it is always between two buckets, and the
+// smallest wedge is the one that leaves out the widest such gap
+void track_bounds(const track *trk, int num_threads,
+                  double *west, double *east, double *north, double *south)
+{
+    int num_segs = track_count_segments(trk);
+    track_span *spans = malloc(sizeof(track_span) * num_segs);
+    long num_pts = 0;
+    for (int curr_seg = 0; curr_seg < num_segs; curr_seg++)
     {
-        trackpoint *pt = seg_get_point(pts, i);
-        double curr_lat = trackpoint_location(pt).lat;
-
-        if (curr_lat < min_lat)
-            min_lat = curr_lat;
-        if (curr_lat > max_lat)
-            max_lat = curr_lat;
+        spans[curr_seg] = track_get_span(trk, curr_seg);
+        num_pts += spans[curr_seg].count;
     }
 
-    // **********************************************************************
-    // identify smallest sector that contains all points
-    // **********************************************************************
+    // no more threads than there are shares of points worth one
+    if (num_threads > num_pts / BOUNDS_POINTS_PER_THREAD)
+        num_threads = num_pts / BOUNDS_POINTS_PER_THREAD;
+    if (num_threads < 1)
+        num_threads = 1;
 
-    // sorts segments array from west to east, starting at longitude 0
-    seg_sort(pts, pt_compare, NULL);
+    int num_buckets = num_pts + 1;
+    lon_bucket *buckets = malloc(sizeof(lon_bucket) * num_buckets);
+    bounds_worker *workers = malloc(sizeof(bounds_worker) * num_threads);
 
-    // makes a sorted list of longitude, without repeated longitudes.
-    // repeated longitudes mess-up the calculation of the smallest sector
-    double *longitudes = malloc((sizeof(double) * num_pts));
-    double prev_lon = 361;
-    int seg_index = 0, lon_list_index = 0;
+    // each worker gets an equal share of the points and of the buckets
+    for (int i = 0; i < num_threads; i++)
+    {
+        bounds_worker *w = &workers[i];
+        w->spans = spans;
+        w->num_segs = num_segs;
+        w->buckets = buckets;
+        w->num_buckets = num_buckets;
+        w->shared = num_threads > 1;
+        w->first_pt = num_pts * i / num_threads;
+        w->end_pt = num_pts * (i + 1) / num_threads;
+        w->first_bucket = (long)num_buckets * i / num_threads;
+        w->end_bucket = (long)num_buckets * (i + 1) / num_threads;
+    }
+
+    run_workers(workers, sizeof(bounds_worker), num_threads, bounds_clear);
+    run_workers(workers, sizeof(bounds_worker), num_threads, bounds_fill);
+    run_workers(workers, sizeof(bounds_worker), num_threads, bounds_scan);
 
-    // seg_print(stdout, pts);
-    // printf("********************\n\n");
+    // **********************************************************************
+    // combines what the workers found, in order from west to east
+    // **********************************************************************
 
-    while (seg_index < num_pts)
+    double min_lat = 90.0; // lat can range from -90 to 90
+    double max_lat = -90.0;
+    int first_used = -1;
+    int last_used = -1;
+    for (int i = 0; i < num_threads; i++)
     {
-        trackpoint *curr_pt = seg_get_point(pts, seg_index);
-        double curr_lon = trackpoint_location(curr_pt).lon;
+        if (workers[i].min_lat < min_lat)
+            min_lat = workers[i].min_lat;
+        if (workers[i].max_lat > max_lat)
+            max_lat = workers[i].max_lat;
 
-        if (curr_lon != prev_lon)
+        if (workers[i].first_used >= 0)
         {
-            longitudes[lon_list_index] = curr_lon;
-            // printf("%lf\n", curr_lon);
-            lon_list_index++;
+            if (first_used < 0)
+                first_used = workers[i].first_used;
+            last_used = workers[i].last_used;
         }
-
-        prev_lon = curr_lon;
-        seg_index++;
     }
 
-    // printf("********************\n\n");
-
-    int num_unique_lon = lon_list_index;
+    double min_sector_start = 0.0;
+    double min_sector_end = 0.0;
 
-    if (num_unique_lon == 1)
+    if (first_used >= 0)
     {
-        min_sector_start = longitudes[0];
-        min_sector_end = min_sector_start;
-        min_sector_size = 0;
-    }
-    else if (num_unique_lon > 1)
-    {
-
-        // iterate through each longitude, calculating how large the sector
-        // would be if that longitude was the western most longitude of the sector
-        // identifies and stores starting longitude of smallest sector
-        min_sector_size = 361.;
-        min_sector_start = 361.;
-        min_sector_end = 361.;
-        for (int index_of_start = 0; index_of_start < num_unique_lon; index_of_start++)
+        // the sector starting at the westernmost longitude wraps around
+        // to end at the easternmost one.  Then each sector starts at
+        // the west of a bucket and ends at the east of the bucket before
+        min_sector_start = buckets[first_used].west;
+        min_sector_end = buckets[last_used].east;
+        double min_sector_size = fmod(min_sector_end - min_sector_start + 360, 360);
+
+        int prev_used = -1;
+        for (int i = 0; i < num_threads; i++)
         {
-            double curr_start = longitudes[index_of_start];
+            bounds_worker *w = &workers[i];
+            if (w->first_used < 0)
+                continue;
 
-            // pts array is storted from west to east, so
-            // (index_of_start - 1) will always be the
-            // corresponding end point of the sector that starts at the
-            // index_of_start point. The modulus allows for treating
-            // the array as a loop to avoid a special edge case
-            int index_of_end = (index_of_start + num_unique_lon - 1) % num_unique_lon;
-            double curr_end = longitudes[index_of_end];
-
-            // adding 360 then taking mod 360 allows for calculating distance
-            // around edge where longitudes go from positive to negative
-            double curr_sector_size = fmod(curr_end - curr_start + 360, 360);
+            if (prev_used >= 0)
+            {
+                double curr_start = buckets[w->first_used].west;
+                double curr_end = buckets[prev_used].east;
+                double curr_sector_size = fmod(curr_end - curr_start + 360, 360);
+                if (curr_sector_size < min_sector_size)
+                {
+                    min_sector_size = curr_sector_size;
+                    min_sector_start = curr_start;
+                    min_sector_end = curr_end;
+                }
+            }
 
-            if (curr_sector_size < min_sector_size)
+            if (w->min_sector_size < min_sector_size)
             {
-                min_sector_size = curr_sector_size;
-                min_sector_start = curr_start;
-                min_sector_end = curr_end;
+                min_sector_size = w->min_sector_size;
+                min_sector_start = w->min_sector_start;
+                min_sector_end = w->min_sector_end;
             }
+            prev_used = w->last_used;
         }
     }
     else
     {
         printf("error in number of unique longitudes\n");
     }
-    free(longitudes);
 
-    // printf("min lat: %lf, max lat: %lf\n\n", min_lat, max_lat);
-
-    // printf("min sector size: %lf, min sector start: %lf\n",
-    //        min_sector_size,
-    //        min_sector_start);
-    // printf("********************\n\n");
+    free(workers);
+    free(buckets);
+    free(spans);
 
     *west = min_sector_start;
     *east = min_sector_end;
     *north = max_lat;
     *south = min_lat;
+}
 
-    seg_destroy(pts);
-    pts = NULL;
+// LOCAL FUNCTIONS
+
+// returns how many degrees east of longitude 0 the given longitude is,
+// the same as fmod(lon + 360, 360) for lon in [-360, 360)
+static double lon_east(double lon)
+{
+    double shifted = lon + 360;
+    return shifted >= 360 ? shifted - 360 : shifted;
 }
 
-// comparison function that orders points from East to West
-int pt_compare(const void *ele1, const void *ele2, const void *arg)
+// returns the part of the given span, of the segment whose first point is
+// point seg_start of the whole track, that is in points [first_pt, end_pt)
+static track_span span_part(track_span span, long seg_start, long first_pt, long end_pt)
 {
-    trackpoint *pt1 = (trackpoint *)ele1;
-    trackpoint *pt2 = (trackpoint *)ele2;
+    long first = first_pt - seg_start > 0 ? first_pt - seg_start : 0;
+    long end = end_pt - seg_start < span.count ? end_pt - seg_start : span.count;
+
+    track_span part;
+    part.lat = span.lat + first;
+    part.lon = span.lon + first;
+    part.time = span.time + first;
+    part.count = end > first ? end - first : 0;
+    return part;
+}
 
-    double lon1 = trackpoint_location(pt1).lon;
-    double lon2 = trackpoint_location(pt2).lon;
+// runs phase on each of the num_workers workers of worker_size bytes
+// each, all but the first on a thread of its own
+static void run_workers(void *workers, size_t worker_size, int num_workers, void *(*phase)(void *))
+{
+    char *worker = workers;
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_workers);
+    int num_started = 1;
+    while (num_started < num_workers
+           && pthread_create(&threads[num_started], NULL, phase, worker + num_started * worker_size) == 0)
+    {
+        num_started++;
+    }
 
-    // adjusts longitudes to be a positive
-    // # degrees east of 0 (ie -179 would map to 181)
-    lon1 = fmod(lon1 + 360, 360);
-    lon2 = fmod(lon2 + 360, 360);
+    // any worker without a thread runs here
+    for (int i = num_started; i < num_workers; i++)
+        phase(worker + i * worker_size);
+    phase(worker);
 
-    if (lon1 < lon2)
-        return (-1); // first is west of second
-    else if (lon1 > lon2)
-        return (1); // second is west of first
-    else
-        return (0);
+    for (int i = 1; i < num_started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+// counts the worker's share of the points in its map, making the map
+// first if it doesn't have one, or for a map too big for that sorts the
+// runs of points in each cell into bands of rows
+static void *heatmap_count(void *arg)
+{
+    heatmap_worker *w = arg;
+    heatmap_run *found = NULL;
+    long num_runs = 0;
+    if (w->by_band) {
+        // there is at most one run per point
+        long share = w->end_pt - w->first_pt;
+        found = malloc(sizeof(heatmap_run) * (share > 0 ? share : 1));
+    }
+    else if (w->counts == NULL) {
+        w->counts = malloc(sizeof(int*) * (w->num_row > 0 ? w->num_row : 1));
+        w->counts[0] = calloc((size_t)w->num_row * w->num_col, sizeof(int));
+        for (int i = 1; i < w->num_row; i++)
+            w->counts[i] = w->counts[0] + (size_t)i * w->num_col;
+    }
+
+    heatmap_grid grid = {w->north, w->west, w->cell_width, w->cell_height, w->num_row};
+    int **hmap = w->counts;
+    int block_rows[HEATMAP_BLOCK];
+    int block_cols[HEATMAP_BLOCK];
+
+    // iterate through the share's trackpoints, straight through each segment's arrays,
+    // a block at a time: find the cell of every point in the block, then
+    // increment the cells in hmap corresponding to them
+    long seg_start = 0;
+    for (int curr_seg = 0; curr_seg < w->num_segs && seg_start < w->end_pt; curr_seg++) {
+        track_span span = span_part(w->spans[curr_seg], seg_start, w->first_pt, w->end_pt);
+        seg_start += w->spans[curr_seg].count;
+
+        for (int first = 0; first < span.count; first += HEATMAP_BLOCK) {
+            int n = span.count - first < HEATMAP_BLOCK ? span.count - first : HEATMAP_BLOCK;
+            heatmap_cells(&grid, span.lat + first, span.lon + first, n, block_rows, block_cols);
+
+            // neighbouring points are mostly in the same cell, so each run
+            // of them is added at once instead of incrementing one cell
+            // over and over
+            int run = 1;
+            for (int i = 1; i <= n; i++) {
+                if (i < n && block_rows[i] == block_rows[i - 1] && block_cols[i] == block_cols[i - 1]) {
+                    run++;
+                }
+                else {
+                    if (w->by_band) {
+                        heatmap_run found_run = {block_rows[i - 1], block_cols[i - 1], run};
+                        found[num_runs++] = found_run;
+                    }
+                    else {
+                        hmap[block_rows[i - 1]][block_cols[i - 1]] += run;
+                    }
+                    run = 1;
+                }
+            }
+        }
+    }
+
+    if (w->by_band) {
+        heatmap_sort_runs(w, found, num_runs);
+        free(found);
+    }
+    return NULL;
+}
+
+// adds the worker's band of rows of every other worker's map into the
+// first worker's
+static void *heatmap_add_up(void *arg)
+{
+    heatmap_worker *w = arg;
+    int **total = w->all[0].counts;
+
+    for (int r = w->first_row; r < w->end_row; r++) {
+        for (int i = 1; i < w->num_workers; i++) {
+            const int *from = w->all[i].counts[r];
+            for (int c = 0; c < w->num_col; c++)
+                total[r][c] += from[c];
+        }
+    }
+    return NULL;
+}
+
+// post: copies the given runs into w->runs, sorted by the band of rows
+// they are in (a counting sort, so runs in the same band keep their
+// order), and sets w->band_start to where each band begins
+static void heatmap_sort_runs(heatmap_worker *w, const heatmap_run *found, long num_runs)
+{
+    int num_bands = w->num_workers;
+    long *start = calloc(num_bands + 1, sizeof(long));
+    for (long i = 0; i < num_runs; i++)
+        start[heatmap_band(w, found[i].row) + 1]++;
+    for (int b = 0; b < num_bands; b++)
+        start[b + 1] += start[b];
+
+    // next[b] is where the next run in band b goes
+    long *next = malloc(sizeof(long) * num_bands);
+    for (int b = 0; b < num_bands; b++)
+        next[b] = start[b];
+    heatmap_run *runs = malloc(sizeof(heatmap_run) * (num_runs > 0 ? num_runs : 1));
+    for (long i = 0; i < num_runs; i++)
+        runs[next[heatmap_band(w, found[i].row)]++] = found[i];
+    free(next);
+
+    w->runs = runs;
+    w->band_start = start;
+}
+
+// returns the index of the worker whose band of rows, [first_row,
+// end_row), has the given row in it
+static int heatmap_band(const heatmap_worker *w, int row)
+{
+    // band b starts at row floor(num_row * b / num_workers)
+    return ((long)(row + 1) * w->num_workers - 1) / w->num_row;
+}
+
+// adds the runs every worker found in this worker's band of rows to the
+// map
+static void *heatmap_add_runs(void *arg)
+{
+    heatmap_worker *w = arg;
+    int band = w - w->all;
+    int **hmap = w->counts;
+
+    for (int i = 0; i < w->num_workers; i++) {
+        const heatmap_worker *from = &w->all[i];
+        for (long j = from->band_start[band]; j < from->band_start[band + 1]; j++)
+            hmap[from->runs[j].row][from->runs[j].col] += from->runs[j].count;
+    }
+    return NULL;
+}
+
+// empties the worker's share of the buckets
+static void *bounds_clear(void *arg)
+{
+    bounds_worker *w = arg;
+    for (int i = w->first_bucket; i < w->end_bucket; i++)
+    {
+        w->buckets[i].west = HUGE_VAL;
+        w->buckets[i].east = -HUGE_VAL;
+    }
+    return NULL;
+}
+
+// finds the northernmost and southernmost of the worker's share of the
+// points, and puts their longitudes in the buckets
+static void *bounds_fill(void *arg)
+{
+    bounds_worker *w = arg;
+    double buckets_per_degree = w->num_buckets / 360.0;
+
+    w->min_lat = 90.0;
+    w->max_lat = -90.0;
+
+    long seg_start = 0;
+    for (int curr_seg = 0; curr_seg < w->num_segs && seg_start < w->end_pt; curr_seg++)
+    {
+        track_span span = span_part(w->spans[curr_seg], seg_start, w->first_pt, w->end_pt);
+        seg_start += w->spans[curr_seg].count;
+
+        for (int i = 0; i < span.count; i++)
+        {
+            double lat = span.lat[i];
+            if (lat < w->min_lat)
+                w->min_lat = lat;
+            if (lat > w->max_lat)
+                w->max_lat = lat;
+
+            double lon = span.lon[i];
+            double lon_x = lon_east(lon);
+            int bucket = lon_x * buckets_per_degree;
+            if (bucket >= w->num_buckets)
+                bucket = w->num_buckets - 1;
+            bucket_add(&w->buckets[bucket], lon, lon_x, w->shared);
+        }
+    }
+    return NULL;
+}
+
+// widens the bucket to take in lon, which is lon_x degrees east of
+// longitude 0.  Shared buckets are compared and swapped atomically, since
+// other threads may be widening the same one
+static void bucket_add(lon_bucket *b, double lon, double lon_x, bool shared)
+{
+    if (!shared)
+    {
+        if (lon_x < lon_east(b->west))
+            b->west = lon;
+        if (lon_x > lon_east(b->east))
+            b->east = lon;
+        return;
+    }
+
+    double curr;
+    __atomic_load(&b->west, &curr, __ATOMIC_RELAXED);
+    while (lon_x < lon_east(curr)
+           && !__atomic_compare_exchange(&b->west, &curr, &lon, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    __atomic_load(&b->east, &curr, __ATOMIC_RELAXED);
+    while (lon_x > lon_east(curr)
+           && !__atomic_compare_exchange(&b->east, &curr, &lon, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// finds the first and last non-empty bucket in the worker's share, and
+// the smallest sector starting at the west of any but the first of them
+// and ending at the east of the non-empty bucket before it
+static void *bounds_scan(void *arg)
+{
+    bounds_worker *w = arg;
+    lon_bucket *buckets = w->buckets;
+
+    w->first_used = -1;
+    w->last_used = -1;
+    w->min_sector_size = 361.;
+    w->min_sector_start = 361.;
+    w->min_sector_end = 361.;
+
+    for (int i = w->first_bucket; i < w->end_bucket; i++)
+    {
+        if (buckets[i].west == HUGE_VAL)
+            continue;
+
+        if (w->last_used < 0)
+        {
+            w->first_used = i;
+        }
+        else
+        {
+            double curr_start = buckets[i].west;
+            double curr_end = buckets[w->last_used].east;
+
+            // adding 360 then taking mod 360 allows for calculating distance
+            // around edge where longitudes go from positive to negative
+            double curr_sector_size = fmod(curr_end - curr_start + 360, 360);
+            if (curr_sector_size < w->min_sector_size)
+            {
+                w->min_sector_size = curr_sector_size;
+                w->min_sector_start = curr_start;
+                w->min_sector_end = curr_end;
+            }
+        }
+        w->last_used = i;
+    }
+    return NULL;
 }
 
 // returns pointer to the segment at index
@@ -0,0 +1,277 @@
+#ifndef __TRACK_H__
+#define __TRACK_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "trackpoint.h"
+#include "location.h"
+#include "heatmap_acc.h"
+#include "heatmap_sparse.h"
+
+typedef struct track track;
+
+// A borrowed view of the points of one segment: point k is at latitude
+// lat[k] and longitude lon[k], with timestamp time[k].  The arrays belong
+// to the track and are only valid until the track is changed.
+typedef struct
+{
+    const double *lat;
+    const double *lon;
+    const long *time;
+    int count;
+} track_span;
+
+// Walks every point of a track in order, segment by segment, without
+// copying them.  Set one up with track_cursor_start; the track must not
+// be changed while it is in use.
+typedef struct
+{
+    const track *trk;
+    int seg;            // the segment span views
+    int next;           // index in span of the next point
+    track_span span;
+} track_cursor;
+
+
+/**
+ * Creates a track with one empty segment.
+ *
+ * @return a pointer to the new track
+ */
+track *track_create();
+
+
+/**
+ * Destroys the given track, releasing all memory held by it.
+ *
+ * @param trk a pointer to a valid track
+ */
+void track_destroy(track *trk);
+
+
+/**
+ * Returns the number of segments in the given track.
+ *
+ * @param trk a pointer to a valid track
+ */
+int track_count_segments(const track *trk);
+
+
+/**
+ * Returns the number of trackpoints in the given segment of the given
+ * track.  The segment is specified by a 0-based index.
+ *
+ * @param trk a pointer to a valid track
+ * @param i a nonnegative integer less than the number of segments in trk
+ * @return the number of trackpoints in the corresponding segment
+ */
+int track_count_points(const track *trk, int i);
+
+
+/**
+ * Returns a copy of the given point in this track.  The caller takes
+ * ownership of the returned track point.  To read points without a copy
+ * each, use track_get_span or a track_cursor.
+ *
+ * @param trk a pointer to a valid track
+ * @param i a nonnegative integer less than the number of segments in trk
+ * @param j a nonnegative integer less than the number of points in segment i
+ * @return a pointer to a copy of the corresponding trackpoint
+ */
+trackpoint *track_get_point(const track *trk, int i, int j);
+
+
+/**
+ * Returns a borrowed view of the points of the given segment of this
+ * track, for reading them without a copy each.  The view is only valid
+ * until the track is changed.
+ *
+ * @param trk a pointer to a valid track
+ * @param i a nonnegative integer less than the number of segments in trk
+ * @return a view of the points of the corresponding segment
+ */
+track_span track_get_span(const track *trk, int i);
+
+
+/**
+ * Sets up the given cursor to walk the points of the given track from the
+ * first point of its first segment.
+ *
+ * @param c a pointer to a cursor
+ * @param trk a pointer to a valid track
+ */
+void track_cursor_start(track_cursor *c, const track *trk);
+
+
+/**
+ * Moves the given cursor to the next point of its track, skipping empty
+ * segments, and returns its location and timestamp through the reference
+ * parameters.
+ *
+ * @param c a pointer to a cursor set up by track_cursor_start
+ * @param loc a pointer to a location, non-NULL
+ * @param time a pointer to a long, or NULL if the timestamp isn't wanted
+ * @return true if there was another point, false once every point has
+ * been walked
+ */
+bool track_cursor_next(track_cursor *c, location *loc, long *time);
+
+
+/**
+ * Returns an array containing the length of each segment in this track.
+ * The caller takes ownership of the returned array.
+ *
+ * @param trk a pointer to a valid track
+ * @return an array of the lengths, in kilometers, of the segments
+ */
+double *track_get_lengths(const track *trk);
+
+
+/**
+ * Adds a copy of the given point to the last segment in this track.
+ *
+ * @param trk a pointer to a valid track
+ * @param pt a pointer to a non-NULL trackpoint
+ */
+void track_add_point(track *trk, const trackpoint *pt);
+
+
+/**
+ * Starts a new segment in the given track.
+ *
+ * @param trk a pointer to a valid track
+ */
+void track_start_segment(track *trk);
+
+
+/**
+ * Merges the given range of segments in this track into one.  The
+ * segments to merge are specified as the 0-based index of the first
+ * segment to merge and one more than the index of the last segment to
+ * merge.
+ *
+ * @param trk a pointer to a valid track
+ * @param start an integer in [0, number of segments)
+ * @param end an integer in [start, number of segments]
+ */
+void track_merge_segments(track *trk, int start, int end);
+
+
+/**
+ * Determines: 1) the latitude of the northernmost and southernmost track points in the given track; and 2)
+ * the meridian of longitude at the western edge of the smallest spherical wedge bounded by two meridians
+ * that contains all the points in the track (the "western edge" for a nontrivial wedge being the one that,
+ * when you move east from it along the equator, you stay in the wedge).  When there are multiple such wedges,
+ * this function finds the one whose western edge is the fewest degrees east of longitude 0.  Takes time
+ * linear in the number of points; large tracks are split between up to num_threads threads.
+ *
+ * @param trk a pointer to a valid, non-empty track
+ * @param num_threads the most threads to use, 1 for none besides the caller's
+ * @param west a pointer to a double in which to record the western edge of the containing wedge
+ * @param east a pointer to a double in which to record the eastern edge of the containing wedge
+ * @param north a pointer to a double in which to record the latitude of the northernmost point
+ * @param south a pointer to a double in which to record the latitude of the southernmost point
+ */
+void track_bounds(const track *trk, int num_threads,
+                  double *west, double *east, double *north, double *south);
+
+
+/**
+ * Creates a heatmap of the given track.  The heatmap will be a
+ * rectangular 2-D array with each row separately allocated.  The last
+ * three paramters are (simulated) reference parameters used to return
+ * the heatmap and its dimensions.  Each element in the heatmap
+ * represents an area bounded by two circles of latitude and two
+ * meridians of longitude.  The circle of latitude bounding the top of
+ * the top row is the northernmost (highest) latitude of any trackpoint
+ * in the given track.  The meridian bounding the west of the first
+ * column is the western edge of the smallest spherical wedge bounded by
+ * two meridians that contains every trackpoint in the track.  The
+ * value in each element is the number of trackpoints located in the
+ * corresponding area.  A point on the boundary between two rows is
+ * counted in the southern one (except on the southern edge of the map)
+ * and a point on the boundary between two columns in the western one.
+ * The caller takes ownership of the returned array.
+ *
+ * @param trk a pointer to a valid, non-empty track
+ * @param cell_width a positive double less than or equal to 360.0
+ * @param cell_height a positive double less than or equal to 180.0
+ * @param map a pointer to a pointer to a 2-D array of ints
+ * @param rows a pointer to an int
+ * @param cols a pointer to an int
+ */
+void track_heatmap(const track *trk, double cell_width, double cell_height,
+                   int ***map, int *rows, int *cols);
+
+
+/**
+ * Creates the same heatmap as track_heatmap, splitting the work between
+ * up to num_threads threads.  Tracks with too few points to be worth
+ * splitting use fewer threads.  Each thread takes a share of the points.
+ * Maps with no more cells than that share are counted a map per thread
+ * and then added up; bigger maps have the cells of each share sorted into
+ * bands of rows, and then each thread counts one band.
+ *
+ * @param trk a pointer to a valid, non-empty track
+ * @param cell_width a positive double less than or equal to 360.0
+ * @param cell_height a positive double less than or equal to 180.0
+ * @param num_threads the most threads to use, 1 for none besides the caller's
+ * @param map a pointer to a pointer to a 2-D array of ints
+ * @param rows a pointer to an int
+ * @param cols a pointer to an int
+ */
+void track_heatmap_threads(const track *trk, double cell_width, double cell_height, int num_threads,
+                           int ***map, int *rows, int *cols);
+
+
+/**
+ * Creates the same heatmap as track_heatmap, keeping only the cells with
+ * points in them, so that memory goes with the number of those cells
+ * rather than the size of the map.  The heatmap returned is finished,
+ * ready to read with an iterator or a band at a time.  The caller takes
+ * ownership of it.
+ *
+ * @param trk a pointer to a valid, non-empty track
+ * @param cell_width a positive double less than or equal to 360.0
+ * @param cell_height a positive double less than or equal to 180.0
+ * @return a pointer to the heatmap
+ */
+heatmap_sparse *track_heatmap_sparse(const track *trk, double cell_width, double cell_height);
+
+
+/**
+ * Starts keeping a heatmap of the given track, counting the points in it
+ * now and each point added from then on, so that the current heatmap can
+ * be read at any time without going over every point again.  Any heatmap
+ * kept before is destroyed.  The parameters are those of
+ * heatmap_acc_create: unlike track_heatmap, the grid stays where it is
+ * put rather than following the bounds of the track.
+ *
+ * @param trk a pointer to a valid track
+ * @param cell_width a positive double less than or equal to 360.0
+ * @param cell_height a positive double less than or equal to 180.0
+ * @param north the latitude of the north edge of row 0
+ * @param west the longitude of the west edge of column 0, in [-180, 180)
+ */
+void track_attach_heatmap(track *trk, double cell_width, double cell_height, double north, double west);
+
+
+/**
+ * Returns the heatmap kept of the given track, or NULL if there is none.
+ * The track keeps ownership of it, and it stays up to date as points are
+ * added until the track is destroyed or another heatmap is attached.
+ *
+ * @param trk a pointer to a valid track
+ */
+const heatmap_acc *track_get_heatmap(const track *trk);
+
+
+/**
+ * Prints the segments of the given track to standard output.
+ *
+ * @param trk a pointer to a valid track
+ */
+void track_print(const track *trk);
+
+#endif
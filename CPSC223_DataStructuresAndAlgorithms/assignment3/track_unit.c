@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "track.h"
 #include "trackpoint.h"
 #include "location.h"
+#include "heatmap_cells.h"
 
 location short_segment[] = {{41.3078680, -72.9342120},
 			  {41.3078780, -72.9342340},
@@ -32,6 +34,12 @@ void add_out_of_order(int new_segments);
 void start_segment_when_empty(const location **pts, int num_segs, int *num_pts);
 void merge(int start_segments, int merge_start, int merge_end);
 void copy_in_add();
+void views(const location **pts, int num_segs, int *num_pts, long t);
+void bounds(int n, double west, double step);
+void kept_heatmap(double north, double west);
+void heatmap_threads(int n, int num_threads, double cell_size);
+void cells(double north, double west, double cell_width, double cell_height);
+void sparse_heatmap(int n, double cell_width, double cell_height);
 void heatmap(int rows, int cols, int counts[][cols], double north, double west);
 void free_heatmap(int **map, int rows);
 
@@ -94,6 +102,42 @@ int main(int argc, char **argv)
       heatmap(small_map_rows, small_map_cols, small_map_counts, 45.0, 179.0);
       break;
 
+    case 12:
+      views(two_segment, 2, two_segment_lengths, 2000);
+      break;
+
+    case 13:
+      // wedge across longitude 180
+      bounds(9, 179.0, 0.25);
+      break;
+
+    case 14:
+      // enough points to be split between threads
+      bounds(1 << 20, 179.5, 1.0 / (1 << 20));
+      break;
+
+    case 15:
+      kept_heatmap(45.0, 179.0);
+      break;
+
+    case 16:
+      heatmap_threads(1 << 20, 4, 0.25);
+      break;
+
+    case 17:
+      // cells that aren't exact in binary, on a grid across longitude 180
+      cells(45.0, 179.3, 0.1, 0.01);
+      break;
+
+    case 18:
+      sparse_heatmap(20000, 0.01, 0.02);
+      break;
+
+    case 19:
+      // more cells than each thread has points
+      heatmap_threads(1 << 20, 4, 0.005);
+      break;
+
     default:
       fprintf(stderr, "%s: invalid test number %s\n", argv[0], argv[1]);
       return 1;
@@ -450,6 +494,463 @@ void copy_in_add()
   printf("PASSED\n");
 }
 
+void views(const location **pts, int num_segs, int *num_pts, long t)
+{
+  // a cursor over an empty track has no points
+  track *trk = track_create();
+  track_start_segment(trk);
+  track_cursor c;
+  location loc;
+  long time;
+  track_cursor_start(&c, trk);
+  if (track_cursor_next(&c, &loc, &time))
+    {
+      printf("ERROR: cursor found a point in an empty track\n");
+      track_destroy(trk);
+      return;
+    }
+  track_destroy(trk);
+
+  // the track gets an empty segment at the end, for the cursor to skip
+  trk = make_track(pts, num_segs, num_pts, t);
+  if (trk == NULL)
+    {
+      return;
+    }
+  track_start_segment(trk);
+
+  // each span holds the same points track_get_point returns copies of
+  for (int seg = 0; seg < num_segs + 1; seg++)
+    {
+      track_span span = track_get_span(trk, seg);
+      if (span.count != track_count_points(trk, seg))
+	{
+	  printf("ERROR: span of segment %d has %d points\n", seg, span.count);
+	  track_destroy(trk);
+	  return;
+	}
+
+      for (int i = 0; i < span.count; i++)
+	{
+	  trackpoint *pt = track_get_point(trk, seg, i);
+	  location expected = trackpoint_location(pt);
+	  if (span.lat[i] != expected.lat || span.lon[i] != expected.lon
+	      || span.time[i] != trackpoint_time(pt))
+	    {
+	      printf("ERROR: span of segment %d has %f %f %ld at %d\n", seg, span.lat[i], span.lon[i], span.time[i], i);
+	      trackpoint_destroy(pt);
+	      track_destroy(trk);
+	      return;
+	    }
+	  trackpoint_destroy(pt);
+	}
+    }
+
+  // the cursor walks every point in order
+  track_cursor_start(&c, trk);
+  long expected_time = t;
+  for (int seg = 0; seg < num_segs; seg++)
+    {
+      for (int i = 0; i < num_pts[seg]; i++)
+	{
+	  if (!track_cursor_next(&c, &loc, &time))
+	    {
+	      printf("ERROR: cursor stopped before segment %d point %d\n", seg, i);
+	      track_destroy(trk);
+	      return;
+	    }
+	  if (loc.lat != pts[seg][i].lat || loc.lon != pts[seg][i].lon || time != expected_time)
+	    {
+	      printf("ERROR: cursor gave %f %f %ld for segment %d point %d\n", loc.lat, loc.lon, time, seg, i);
+	      track_destroy(trk);
+	      return;
+	    }
+	  expected_time++;
+	}
+    }
+
+  if (track_cursor_next(&c, &loc, NULL))
+    {
+      printf("ERROR: cursor went past the last point\n");
+      track_destroy(trk);
+      return;
+    }
+
+  track_destroy(trk);
+  printf("PASSED\n");
+}
+
+void bounds(int n, double west, double step)
+{
+  // n points step degrees apart, east from west, added out of order
+  // and spread over a few segments
+  track *trk = track_create();
+  int stride = 7;
+  for (int i = 0; i < n; i++)
+    {
+      int k = (long)i * stride % n;
+      double lon = west + k * step;
+      if (lon >= 180.0)
+	{
+	  lon -= 360.0;
+	}
+
+      if (i % (n / 3 + 1) == n / 3)
+	{
+	  track_start_segment(trk);
+	}
+      trackpoint *pt = trackpoint_create(-10.0 + k * 20.0 / n, lon, i);
+      track_add_point(trk, pt);
+      trackpoint_destroy(pt);
+    }
+
+  double expected_east = west + (n - 1) * step;
+  if (expected_east >= 180.0)
+    {
+      expected_east -= 360.0;
+    }
+
+  int threads[] = {1, 4};
+  for (int i = 0; i < 2; i++)
+    {
+      double w, e, north, south;
+      track_bounds(trk, threads[i], &w, &e, &north, &south);
+      if (w != west || e != expected_east || north != -10.0 + (n - 1) * 20.0 / n || south != -10.0)
+	{
+	  printf("ERROR: bounds with %d threads are W %f E %f N %f S %f\n", threads[i], w, e, north, south);
+	  track_destroy(trk);
+	  return;
+	}
+    }
+
+  track_destroy(trk);
+  printf("PASSED\n");
+}
+
+void kept_heatmap(double north, double west)
+{
+  // cells in 1 degree rows and columns south and east of the corner,
+  // far enough apart that the kept heatmap has to grow every way, with
+  // how many points go in each; the last is for a point on a corner
+  int cells[][3] = {{0, 0, 2}, {5, 3, 1}, {-20, 1, 3}, {2, 300, 1}, {40, 359, 2}, {-3, 0, 1}, {7, 9, 1}};
+  int num_cells = sizeof(cells) / sizeof(cells[0]);
+  int attach_after = 2;
+
+  track *trk = track_create();
+  long time = 1000;
+  int num_pts = 0;
+  for (int i = 0; i < num_cells; i++)
+    {
+      if (i == attach_after)
+	{
+	  // the points already there are counted when it is attached
+	  track_attach_heatmap(trk, 1.0, 1.0, north, west);
+	}
+
+      for (int p = 0; p < cells[i][2]; p++)
+	{
+	  double lat = north - cells[i][0] - 0.5;
+	  double lon = west + cells[i][1] + 0.5;
+	  if (i == num_cells - 1)
+	    {
+	      // on the corner of four cells, so counted in the south-west one
+	      lat = north - cells[i][0];
+	      lon = west + cells[i][1] + 1;
+	    }
+	  if (lon >= 180.0)
+	    {
+	      lon -= 360.0;
+	    }
+
+	  trackpoint *pt = trackpoint_create(lat, lon, time++);
+	  track_add_point(trk, pt);
+	  trackpoint_destroy(pt);
+	  num_pts++;
+	}
+    }
+
+  const heatmap_acc *acc = track_get_heatmap(trk);
+  if (acc == NULL || heatmap_acc_count(acc) != num_pts)
+    {
+      printf("ERROR: kept heatmap didn't count every point\n");
+      track_destroy(trk);
+      return;
+    }
+
+  int min_row = cells[0][0], max_row = cells[0][0];
+  int min_col = cells[0][1], max_col = cells[0][1];
+  for (int i = 1; i < num_cells; i++)
+    {
+      min_row = cells[i][0] < min_row ? cells[i][0] : min_row;
+      max_row = cells[i][0] > max_row ? cells[i][0] : max_row;
+      min_col = cells[i][1] < min_col ? cells[i][1] : min_col;
+      max_col = cells[i][1] > max_col ? cells[i][1] : max_col;
+    }
+
+  int **map;
+  int rows, cols;
+  double map_north, map_west;
+  heatmap_acc_get(acc, &map, &rows, &cols, &map_north, &map_west);
+  if (rows != max_row - min_row + 1 || cols != max_col - min_col + 1
+      || map_north != north - min_row || map_west != west + min_col)
+    {
+      printf("ERROR: kept heatmap is %d by %d from %f %f\n", rows, cols, map_north, map_west);
+      free_heatmap(map, rows);
+      track_destroy(trk);
+      return;
+    }
+
+  int total = 0;
+  for (int r = 0; r < rows; r++)
+    {
+      for (int c = 0; c < cols; c++)
+	{
+	  int expected = 0;
+	  for (int i = 0; i < num_cells; i++)
+	    {
+	      if (cells[i][0] == r + min_row && cells[i][1] == c + min_col)
+		{
+		  expected = cells[i][2];
+		}
+	    }
+	  if (map[r][c] != expected)
+	    {
+	      printf("ERROR: kept heatmap has %d in cell %d %d\n", map[r][c], r + min_row, c + min_col);
+	      free_heatmap(map, rows);
+	      track_destroy(trk);
+	      return;
+	    }
+	  total += map[r][c];
+	}
+    }
+
+  free_heatmap(map, rows);
+  track_destroy(trk);
+  if (total == num_pts)
+    {
+      printf("PASSED\n");
+    }
+  else
+    {
+      printf("ERROR: kept heatmap has %d points\n", total);
+    }
+}
+
+void heatmap_threads(int n, int num_threads, double cell_size)
+{
+  // n points on a spiral out from near longitude 180, spread over a few
+  // segments, many of them on cell boundaries
+  track *trk = track_create();
+  for (int i = 0; i < n; i++)
+    {
+      if (i % (n / 5) == 0)
+	{
+	  track_start_segment(trk);
+	}
+
+      double r = 4.0 * i / n;
+      double lat = 10.0 + r * sin(i * 0.001);
+      double lon = 179.0 + r * cos(i * 0.001);
+      if (i % 7 == 0)
+	{
+	  lat = floor(lat * 4) / 4;
+	  lon = floor(lon * 4) / 4;
+	}
+      if (lon >= 180.0)
+	{
+	  lon -= 360.0;
+	}
+
+      trackpoint *pt = trackpoint_create(lat, lon, i);
+      track_add_point(trk, pt);
+      trackpoint_destroy(pt);
+    }
+
+  int **serial_map;
+  int serial_rows, serial_cols;
+  track_heatmap(trk, cell_size, cell_size, &serial_map, &serial_rows, &serial_cols);
+
+  int **map;
+  int rows, cols;
+  track_heatmap_threads(trk, cell_size, cell_size, num_threads, &map, &rows, &cols);
+  track_destroy(trk);
+
+  if (rows != serial_rows || cols != serial_cols)
+    {
+      printf("ERROR: map is %d by %d with threads, %d by %d without\n", rows, cols, serial_rows, serial_cols);
+      free_heatmap(map, rows);
+      free_heatmap(serial_map, serial_rows);
+      return;
+    }
+
+  for (int r = 0; r < rows; r++)
+    {
+      for (int c = 0; c < cols; c++)
+	{
+	  if (map[r][c] != serial_map[r][c])
+	    {
+	      printf("ERROR: cell %d %d is %d with threads, %d without\n", r, c, map[r][c], serial_map[r][c]);
+	      free_heatmap(map, rows);
+	      free_heatmap(serial_map, serial_rows);
+	      return;
+	    }
+	}
+    }
+
+  free_heatmap(map, rows);
+  free_heatmap(serial_map, serial_rows);
+  printf("PASSED\n");
+}
+
+void cells(double north, double west, double cell_width, double cell_height)
+{
+  // points on and between cell boundaries, and south of the grid, in an
+  // odd number so some are left over after any block of four
+  int n = 1001;
+  double lat[1001];
+  double lon[1001];
+  for (int i = 0; i < n; i++)
+    {
+      lat[i] = north - (i % 3 == 0 ? i : i + 0.5) * cell_height;
+      lon[i] = west + (i % 2 == 0 ? i : i + 0.5) * cell_width;
+      if (lon[i] >= 180.0)
+	{
+	  lon[i] -= 360.0;
+	}
+    }
+
+  heatmap_grid grid = {north, west, cell_width, cell_height, 800};
+  int rows[1001];
+  int cols[1001];
+  heatmap_cells(&grid, lat, lon, n, rows, cols);
+
+  for (int i = 0; i < n; i++)
+    {
+      // the rules as track_heatmap has always applied them
+      double deg_south = north - lat[i];
+      double deg_east = fmod(lon[i] - west + 360, 360);
+      int row = fmin(floor(deg_south / cell_height), grid.num_row - 1);
+      int col = floor(deg_east / cell_width);
+      if (fmod(deg_east, cell_width) == 0. && col > 0)
+	{
+	  col--;
+	}
+
+      if (rows[i] != row || cols[i] != col)
+	{
+	  printf("ERROR: point %d at %f %f is in cell %d %d, not %d %d\n", i, lat[i], lon[i], rows[i], cols[i], row, col);
+	  return;
+	}
+    }
+  printf("PASSED\n");
+}
+
+void sparse_heatmap(int n, double cell_width, double cell_height)
+{
+  // a spiral across longitude 180, with some points on cell boundaries
+  // and some repeated so cells get runs of points
+  track *trk = track_create();
+  for (int i = 0; i < n; i++)
+    {
+      double r = 2.0 * i / n;
+      double lat = -30.0 + r * sin(i * 0.01);
+      double lon = 179.5 + r * cos(i * 0.01);
+      if (i % 5 == 0)
+	{
+	  lat = floor(lat / cell_height) * cell_height;
+	  lon = floor(lon / cell_width) * cell_width;
+	}
+      if (lon >= 180.0)
+	{
+	  lon -= 360.0;
+	}
+
+      trackpoint *pt = trackpoint_create(lat, lon, i);
+      track_add_point(trk, pt);
+      if (i % 11 == 0)
+	{
+	  track_add_point(trk, pt);
+	}
+      trackpoint_destroy(pt);
+    }
+
+  int **map;
+  int rows, cols;
+  track_heatmap(trk, cell_width, cell_height, &map, &rows, &cols);
+  heatmap_sparse *sparse = track_heatmap_sparse(trk, cell_width, cell_height);
+  track_destroy(trk);
+
+  if (heatmap_sparse_rows(sparse) != rows || heatmap_sparse_cols(sparse) != cols)
+    {
+      printf("ERROR: sparse map is %d by %d, not %d by %d\n", heatmap_sparse_rows(sparse), heatmap_sparse_cols(sparse), rows, cols);
+      heatmap_sparse_destroy(sparse);
+      free_heatmap(map, rows);
+      return;
+    }
+
+  // the iterator gives every cell with points, in order, from the middle
+  // row on, and nothing else
+  int first_row = rows / 2;
+  long cells = 0;
+  for (int r = first_row; r < rows; r++)
+    {
+      for (int c = 0; c < cols; c++)
+	{
+	  cells += map[r][c] > 0;
+	}
+    }
+
+  heatmap_sparse_iter it;
+  heatmap_sparse_cell cell;
+  heatmap_sparse_iter_start(&it, sparse, first_row);
+  long walked = 0;
+  long prev = -1;
+  while (heatmap_sparse_iter_next(&it, &cell))
+    {
+      long at = (long)cell.row * cols + cell.col;
+      if (cell.row < first_row || at <= prev || cell.count != map[cell.row][cell.col])
+	{
+	  printf("ERROR: iterator gave %d points in cell %d %d\n", cell.count, cell.row, cell.col);
+	  heatmap_sparse_destroy(sparse);
+	  free_heatmap(map, rows);
+	  return;
+	}
+      prev = at;
+      walked++;
+    }
+
+  // a band of three rows matches the dense map, zeros and all
+  int *band = malloc(sizeof(int) * 3 * cols);
+  heatmap_sparse_band(sparse, first_row, 3, band);
+  for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < cols; c++)
+	{
+	  if (band[r * cols + c] != map[first_row + r][c])
+	    {
+	      printf("ERROR: band has %d in cell %d %d\n", band[r * cols + c], first_row + r, c);
+	      free(band);
+	      heatmap_sparse_destroy(sparse);
+	      free_heatmap(map, rows);
+	      return;
+	    }
+	}
+    }
+
+  free(band);
+  heatmap_sparse_destroy(sparse);
+  free_heatmap(map, rows);
+
+  if (walked == cells)
+    {
+      printf("PASSED\n");
+    }
+  else
+    {
+      printf("ERROR: iterator gave %ld cells, not %ld\n", walked, cells);
+    }
+}
+
 void heatmap(int rows, int cols, int counts[][cols], double north, double west)
 {
   double cell_width = 1.0;
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "trackpoint.h"
 
@@ -27,6 +28,21 @@ trackpoint *trackpoint_create(double lat, double lon, long time)
     }
 }
 
+bool trackpoint_set(trackpoint *pt, double lat, double lon, long time)
+{
+  if (lat >= -90.0 && lat <= 90.0 && lon >= -180.0 && lon < 180.0)
+    {
+      pt->loc.lat = lat;
+      pt->loc.lon = lon;
+      pt->time = time;
+      return true;
+    }
+  else
+    {
+      return false;
+    }
+}
+
 trackpoint *trackpoint_copy(const trackpoint *pt)
 {
   return trackpoint_create(pt->loc.lat, pt->loc.lon, pt->time);
@@ -0,0 +1,74 @@
+#ifndef __TRACKPOINT_H__
+#define __TRACKPOINT_H__
+
+#include <stdbool.h>
+
+#include "location.h"
+
+typedef struct trackpoint trackpoint;
+
+
+/**
+ * Creates a track point with the given location and time.  Returns NULL
+ * if the latitude is not in [-90, 90] or the longitude is not in
+ * [-180, 180), or if allocation fails.  The caller takes ownership of
+ * the returned point.
+ *
+ * @param lat a latitude
+ * @param lon a longitude
+ * @param time a timestamp
+ * @return a pointer to the new point, or NULL
+ */
+trackpoint *trackpoint_create(double lat, double lon, long time);
+
+
+/**
+ * Changes the location and time of the given point, so one point can be
+ * reused instead of creating a new one each time.  The point is left
+ * unchanged if the location is out of range (as for trackpoint_create).
+ *
+ * @param pt a pointer to a track point, non-NULL
+ * @param lat a latitude
+ * @param lon a longitude
+ * @param time a timestamp
+ * @return true if and only if the point was changed
+ */
+bool trackpoint_set(trackpoint *pt, double lat, double lon, long time);
+
+
+/**
+ * Returns a copy of the given point.  The caller takes ownership of the
+ * copy.
+ *
+ * @param pt a pointer to a track point, non-NULL
+ * @return a pointer to the copy, or NULL if allocation fails
+ */
+trackpoint *trackpoint_copy(const trackpoint *pt);
+
+
+/**
+ * Destroys the given point.
+ *
+ * @param pt a pointer to a track point, non-NULL
+ */
+void trackpoint_destroy(trackpoint *pt);
+
+
+/**
+ * Returns the location of the given point.
+ *
+ * @param pt a pointer to a track point, non-NULL
+ * @return its location
+ */
+location trackpoint_location(const trackpoint *pt);
+
+
+/**
+ * Returns the timestamp of the given point.
+ *
+ * @param pt a pointer to a track point, non-NULL
+ * @return its timestamp
+ */
+long trackpoint_time(const trackpoint *pt);
+
+#endif
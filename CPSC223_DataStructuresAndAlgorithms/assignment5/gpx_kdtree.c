@@ -0,0 +1,70 @@
+// Jacob Lessing
+// CPSC 223 Fall 2022
+
+// Reads the trkpt locations of a GPX file into a k-d tree in balanced batches
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "kdtree.h"
+#include "location.h"
+#include "gpx_input.h"
+#include "gpx_reader.h"
+#include "gpx_pipe.h"
+#include "gpx_kdtree.h"
+
+// starting size of the array when the whole input is one batch
+#define INITIAL_CAPACITY (1024)
+
+
+int gpx_kdtree_read(gpx_input *in, kdtree *t, int batch_size)
+{
+    gpx_record fields;
+    int num_added = 0;
+
+    int capacity = batch_size > 0 ? batch_size : INITIAL_CAPACITY;
+    int len = 0;
+    location *pts = malloc(sizeof(*pts) * capacity);
+
+    // the input is parsed on another thread while the locations are
+    // gathered and added here
+    gpx_reader *r = gpx_reader_create(in);
+    gpx_pipe *p = gpx_pipe_create(GPX_PIPE_DEFAULT_BATCHES);
+    if (pts == NULL || r == NULL || p == NULL || gpx_pipe_start(p, r)) {
+        gpx_pipe_destroy(p);
+        gpx_reader_destroy(r);
+        free(pts);
+        return -1;
+    }
+
+    while (gpx_pipe_get(p, &fields)) {
+        if (fields.kind != GPX_POINT || !fields.has_location) continue;
+
+        location loc = {fields.latitude, fields.longitude};
+        if (!location_validate(&loc)) continue;
+
+        if (len == capacity) {
+            if (batch_size > 0) {
+                num_added += kdtree_add_batch(t, pts, len);
+                len = 0;
+            }
+            else {
+                location *bigger = realloc(pts, sizeof(*pts) * capacity * 2);
+                if (bigger == NULL) {
+                    num_added = -1;
+                    break;
+                }
+                pts = bigger;
+                capacity *= 2;
+            }
+        }
+        pts[len++] = loc;
+    }
+
+    if (num_added >= 0) num_added += kdtree_add_batch(t, pts, len);
+
+    gpx_pipe_destroy(p);
+    gpx_reader_destroy(r);
+    free(pts);
+    return num_added;
+}
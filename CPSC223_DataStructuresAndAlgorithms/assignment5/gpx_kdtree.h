@@ -0,0 +1,26 @@
+#ifndef __GPX_KDTREE_H__
+#define __GPX_KDTREE_H__
+
+#include "kdtree.h"
+#include "gpx_input.h"
+
+
+/**
+ * Adds the locations of the trkpts of the given GPX input to the given
+ * k-d tree, without going through parse_GPX's text output.  The
+ * decoded locations are gathered into one array and added with
+ * kdtree_add_batch, batch_size at a time, so each batch becomes a
+ * balanced subtree; with batch_size 0 the whole input is one batch, and
+ * reading into an empty tree builds it balanced in one go.  Points
+ * whose location is missing or out of range are skipped.
+ *
+ * @param in a pointer to an input, non-NULL
+ * @param t a pointer to a valid k-d tree
+ * @param batch_size the most points to gather before adding them, or 0
+ * to gather them all
+ * @return the number of points added, or -1 if memory runs out (the
+ * batches added before then stay in the tree)
+ */
+int gpx_kdtree_read(gpx_input *in, kdtree *t, int batch_size);
+
+#endif
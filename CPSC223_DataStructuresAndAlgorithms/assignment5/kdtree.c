@@ -37,6 +37,8 @@ static node* find_max(node* n, int search_dim);
 static node* min_node(node* a, node* b, int dim);
 static node* max_node(node* a, node* b, int dim);
 static node* create_helper(location **pts, node* p, int n, int dim);
+static int unique_copies(const location *pts, int n, location **copies);
+static int merge_helper(node** slot, node* p, location **pts, int n, int dim);
 static void destroy_helper(node* root);
 static void remove_helper(node* n, kdtree* t);
 static void range_for_each_helper(node* n, region r, region b, void (*f)(const location *, void *), void *arg);
@@ -68,40 +70,15 @@ kdtree *kdtree_create(const location *pts, int n)
 {
     int len;                        // number of unique points
     location** pts_cleaned;         // array of unique, valid points
-    location *curr_loc, *prev_loc;
 
     // initalize new kdtree
     kdtree* new_tree = malloc(sizeof(*new_tree));
     new_tree->root = NULL;
     if (n == 0) return new_tree;
 
-    // remove duplicate & invalid points
-    // is there a better way of doing this?
-    
-    // COPY all points to new array of pointers
+    // COPY all unique points to new array of pointers
     pts_cleaned = malloc(sizeof(*pts_cleaned) * n);
-    for (int i = 0; i < n; i++) {
-        pts_cleaned[i] = copyLocation(&pts[i]);
-    }
-    
-    // sort new array
-    qsort(pts_cleaned, n, sizeof(*pts_cleaned), compare_helper_dim_LAT);
-    
-    len = 1;
-    prev_loc = pts_cleaned[0];    
-    // iterate through elements in pts array
-    for (int i = 1; i < n; i++)
-    {
-        curr_loc = pts_cleaned[i];
-        if (!coordsAreEqual(prev_loc, curr_loc))
-        {
-            assert(location_validate(curr_loc));
-            // moves valid, unique points to appropriate index in "clean" array
-            pts_cleaned[len] = curr_loc;
-            len++;
-        }
-        prev_loc = curr_loc;
-    }
+    len = unique_copies(pts, n, pts_cleaned);
 
     new_tree->root = create_helper(pts_cleaned, NULL, len, ROOT_CUTTING_DIM);
     free(pts_cleaned);
@@ -109,6 +86,35 @@ kdtree *kdtree_create(const location *pts, int n)
     return new_tree;
 }
 
+/**
+ * Adds copies of the points in the given array of locations to the
+ * given k-d tree.  The new points are passed down the tree together,
+ * and the ones that reach each empty spot are built into a balanced
+ * subtree there, as kdtree_create would build them.  So a batch added
+ * to an empty tree gives a balanced tree, and a batch added to a tree
+ * costs O(m log^2 m) for m points instead of m separate adds that each
+ * lengthen one path.  Points already in the tree, and repeats in the
+ * array, are added once.
+ *
+ * @param t a pointer to a valid k-d tree, non-NULL
+ * @param pts an array of valid locations; NULL is allowed if n = 0
+ * @param n the number of points to add from the beginning of that array,
+ * or 0 if pts is NULL
+ * @return the number of points added
+ */
+int kdtree_add_batch(kdtree *t, const location *pts, int n)
+{
+    if (n == 0) return 0;
+
+    location** copies = malloc(sizeof(*copies) * n);
+    int len = unique_copies(pts, n, copies);
+
+    int added = merge_helper(&t->root, NULL, copies, len, ROOT_CUTTING_DIM);
+    free(copies);
+
+    return added;
+}
+
 /**
  * Adds a copy of the given point to the given k-d tree.  There is no
  * effect if the point is already in the tree.  The tree need not be
@@ -603,6 +609,90 @@ static node* create_helper(location **pts, node* p, int n, int dim)
     return root;
 }
 
+// copies the n points in pts into copies, sorted by latitude and
+// without duplicates
+// returns the number of unique points copied
+static int unique_copies(const location *pts, int n, location **copies)
+{
+    for (int i = 0; i < n; i++) {
+        copies[i] = copyLocation(&pts[i]);
+    }
+
+    // sort new array, so duplicates are next to each other
+    qsort(copies, n, sizeof(*copies), compare_helper_dim_LAT);
+
+    int len = 1;
+    assert(location_validate(copies[0]));
+    for (int i = 1; i < n; i++)
+    {
+        if (coordsAreEqual(copies[len - 1], copies[i]))
+        {
+            free(copies[i]);
+        }
+        else
+        {
+            assert(location_validate(copies[i]));
+            // moves unique points to appropriate index in array
+            copies[len] = copies[i];
+            len++;
+        }
+    }
+
+    return len;
+}
+
+// slot is the child pointer (or root) to merge the points into, and p
+// its parent node; dim is the cutting dimension of a node at slot
+// the n points in pts are unique copies; the tree takes ownership of
+// those it adds and the others are freed
+// returns the number of points added
+static int merge_helper(node** slot, node* p, location **pts, int n, int dim)
+{
+    if (n == 0) return 0;
+
+    node* curr = *slot;
+    if (curr == NULL)
+    {
+        *slot = create_helper(pts, p, n, dim);
+        return n;
+    }
+
+    // drop the point already at this node, then move the points that
+    // belong in the left subtree to the front
+    int len = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (coordsAreEqual(pts[i], curr->loc)) free(pts[i]);
+        else pts[len++] = pts[i];
+    }
+
+    int nLeft = 0;
+    for (int i = 0; i < len; i++)
+    {
+        int compare;
+        if (curr->cutting_dim == LAT)
+        {
+            compare = location_compare_latitude(pts[i], curr->loc);
+        }
+        else
+        {
+            compare = location_compare_longitude(pts[i], curr->loc);
+        }
+
+        if (compare < 0)
+        {
+            location* temp = pts[nLeft];
+            pts[nLeft] = pts[i];
+            pts[i] = temp;
+            nLeft++;
+        }
+    }
+
+    int nextDim = (curr->cutting_dim + 1) % 2;
+    return merge_helper(&curr->left, curr, pts, nLeft, nextDim)
+           + merge_helper(&curr->right, curr, pts + nLeft, len - nLeft, nextDim);
+}
+
 static void destroy_helper(node* root) {
     // base case
     if (root == NULL) return;
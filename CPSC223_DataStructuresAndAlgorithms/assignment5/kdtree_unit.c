@@ -5,6 +5,9 @@
 
 #include "kdtree.h"
 #include "location.h"
+#include "gpx_input.h"
+#include "gpx_reader.h"
+#include "gpx_kdtree.h"
 
 void unit_test_remove(size_t n, bool readd);
 void unit_test_add(size_t n);
@@ -12,6 +15,8 @@ void unit_test_build(size_t n);
 void unit_test_contains(size_t n);
 void unit_test_for_each(size_t n, double sw_lat, double sw_lon, double ne_lat, double ne_lon, bool add_borders);
 void unit_test_range(size_t n, double sw_lat, double sw_lon, double ne_lat, double ne_lon);
+void unit_test_add_batch(size_t n, int batch_size);
+void unit_test_gpx(const char *path, int batch_size);
 
 void unit_test_add_time_random(size_t n, int on, double lat_scale, double lon_scale);
 void unit_test_range_time(size_t n, int on, double lat_scale, double lon_scale);
@@ -166,6 +171,21 @@ int main(int argc, char **argv)
 	}
       break;
 
+    case 18:
+      unit_test_add_batch(1000, 100);
+      break;
+
+    case 19:
+      unit_test_add_batch(1000, 1000);
+      break;
+
+    case 20:
+      if (argc > 3)
+	{
+	  unit_test_gpx(argv[2], atoi(argv[3]));
+	}
+      break;
+
     default:
       fprintf(stderr, "USAGE: %s test-number\n", argv[0]);
       return 1;
@@ -243,6 +263,144 @@ void unit_test_build(size_t n)
 }
 
 
+void unit_test_add_batch(size_t n, int batch_size)
+{
+  // n random points on a coarse grid, so some are repeated
+  location *random_points = malloc(sizeof(location) * n);
+  for (size_t i = 0; i < n; i++)
+    {
+      random_points[i].lat = rand() % 64 * 0.5;
+      random_points[i].lon = rand() % 64 * 0.5;
+    }
+
+  // count the unique points
+  int unique = 0;
+  for (size_t i = 0; i < n; i++)
+    {
+      size_t j = 0;
+      while (j < i && location_compare_latitude(&random_points[j], &random_points[i]) != 0)
+	{
+	  j++;
+	}
+      if (j == i)
+	{
+	  unique++;
+	}
+    }
+
+  // start with the test points added one at a time, so the batches are
+  // merged into a tree that already has nodes
+  kdtree *t = kdtree_create(NULL, 0);
+  for (size_t i = 0; i < unit_test_count; i++)
+    {
+      kdtree_add(t, &unit_test_points[i]);
+    }
+
+  // add the random points in batches; the last batch is added twice
+  int added = 0;
+  for (size_t i = 0; i < n; i += batch_size)
+    {
+      int len = n - i < batch_size ? n - i : batch_size;
+      added += kdtree_add_batch(t, random_points + i, len);
+    }
+  if (n > 0)
+    {
+      added += kdtree_add_batch(t, random_points + (n - 1) / batch_size * batch_size, (n - 1) % batch_size + 1);
+    }
+
+  if (added != unique)
+    {
+      printf("FAILED -- added %d points; expected %d\n", added, unique);
+      free(random_points);
+      kdtree_destroy(t);
+      return;
+    }
+
+  // verify that contains finds both the test points and the batches
+  for (size_t i = 0; i < unit_test_count; i++)
+    {
+      if (!kdtree_contains(t, &unit_test_points[i]))
+	{
+	  printf("FAILED -- lost point %f %f\n", unit_test_points[i].lat, unit_test_points[i].lon);
+	  free(random_points);
+	  kdtree_destroy(t);
+	  return;
+	}
+    }
+  for (size_t i = 0; i < n; i++)
+    {
+      if (!kdtree_contains(t, &random_points[i]))
+	{
+	  printf("FAILED -- missing point %f %f\n", random_points[i].lat, random_points[i].lon);
+	  free(random_points);
+	  kdtree_destroy(t);
+	  return;
+	}
+    }
+
+  // a point off the grid was never added
+  location off_grid = {0.25, 0.25};
+  if (kdtree_contains(t, &off_grid))
+    {
+      printf("FAILED -- contains point %f %f\n", off_grid.lat, off_grid.lon);
+      free(random_points);
+      kdtree_destroy(t);
+      return;
+    }
+
+  // free resources
+  free(random_points);
+  kdtree_destroy(t);
+  printf("PASSED\n");
+}
+
+
+void unit_test_gpx(const char *path, int batch_size)
+{
+  // read the file into an empty tree
+  gpx_input *in = gpx_input_open(path);
+  if (in == NULL)
+    {
+      printf("FAILED -- could not open %s\n", path);
+      return;
+    }
+  kdtree *t = kdtree_create(NULL, 0);
+  int added = gpx_kdtree_read(in, t, batch_size);
+  gpx_input_close(in);
+
+  if (added < 0)
+    {
+      printf("FAILED -- could not read %s\n", path);
+      kdtree_destroy(t);
+      return;
+    }
+
+  // read the file again and verify that contains finds every location
+  in = gpx_input_open(path);
+  gpx_reader *r = gpx_reader_create(in);
+  gpx_point pt;
+  int found;
+  while ((found = gpx_read_next(r, &pt)) != GPX_END)
+    {
+      location loc = {pt.latitude, pt.longitude};
+      if (found == GPX_POINT && pt.has_location && location_validate(&loc)
+	  && !kdtree_contains(t, &loc))
+	{
+	  printf("FAILED -- missing point %f %f\n", loc.lat, loc.lon);
+	  gpx_reader_destroy(r);
+	  gpx_input_close(in);
+	  kdtree_destroy(t);
+	  return;
+	}
+    }
+
+  gpx_reader_destroy(r);
+  gpx_input_close(in);
+  kdtree_destroy(t);
+  printf("PASSED -- %d points\n", added);
+}
+
+
 void unit_test_contains(size_t n)
 {
   // build an empty tree
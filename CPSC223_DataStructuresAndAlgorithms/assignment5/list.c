@@ -41,7 +41,7 @@ void list_embiggen(list *l)
   // reminds us that "a noble spirit embiggens the smallest [hu]man"
   if (l->capacity > 0 && l->size == l->capacity)
     {
-      int *bigger = realloc(l->elements, sizeof(*l->elements) * l->capacity * 2);
+      location *bigger = realloc(l->elements, sizeof(*l->elements) * l->capacity * 2);
       if (bigger != NULL)
 	{
 	  l->elements = bigger;
@@ -60,8 +60,8 @@ void list_add(list *l, location item)
 
 location* list_copy_data_array(const list* l)
 {
-    list* copy = malloc(sizeof(*l) * l->size);
-    memcpy(copy, l->elements, sizeof(*l) * l->size);
+    location* copy = malloc(sizeof(*l->elements) * l->size);
+    memcpy(copy, l->elements, sizeof(*l->elements) * l->size);
     return copy;
 }
 
@@ -0,0 +1,51 @@
+#ifndef __LIST_H__
+#define __LIST_H__
+
+#include "location.h"
+
+typedef struct _list list;
+
+
+/**
+ * Creates an empty list of locations.
+ *
+ * @return a pointer to the new list
+ */
+list *list_create();
+
+
+/**
+ * Returns the number of locations in the given list.
+ *
+ * @param l a pointer to a list, non-NULL
+ */
+int list_size(const list *l);
+
+
+/**
+ * Adds a copy of the given location to the end of the given list.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @param item a location
+ */
+void list_add(list *l, location item);
+
+
+/**
+ * Returns a copy of the locations in the given list, in order, as an
+ * array.  The caller takes ownership of the array.
+ *
+ * @param l a pointer to a list, non-NULL
+ * @return a pointer to an array of list_size(l) locations
+ */
+location* list_copy_data_array(const list* l);
+
+
+/**
+ * Destroys the given list.
+ *
+ * @param l a pointer to a list, non-NULL
+ */
+void list_destroy(list *l);
+
+#endif
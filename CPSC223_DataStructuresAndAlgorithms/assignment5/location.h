@@ -0,0 +1,56 @@
+#ifndef __LOCATION_H__
+#define __LOCATION_H__
+
+#include <stdbool.h>
+
+typedef struct
+{
+  double lat;
+  double lon;
+} location;
+
+
+/**
+ * Determines if the given location is valid.  A valid location
+ * has finite latitude between -90 and 90 (inclusive) and finite
+ * longitude.
+ *
+ * @param l a pointer to a location, or NULL
+ * @return true if and only if the location is non-NULL and valid
+ */
+int location_validate(const location *l);
+
+
+/**
+ * Compares the two locations by latitude, breaking ties by longitude.
+ *
+ * @param l1 a pointer to a location, non-NULL
+ * @param l2 a pointer to a location, non-NULL
+ * @return a negative number if l1 comes first, a positive number if l2
+ * comes first, and 0 if they are the same
+ */
+int location_compare_latitude(const location *l1, const location *l2);
+
+
+/**
+ * Compares the two locations by longitude, breaking ties by latitude.
+ *
+ * @param l1 a pointer to a location, non-NULL
+ * @param l2 a pointer to a location, non-NULL
+ * @return a negative number if l1 comes first, a positive number if l2
+ * comes first, and 0 if they are the same
+ */
+int location_compare_longitude(const location *l1, const location *l2);
+
+
+/**
+ * Returns the distance in kilometers between the two locations on the
+ * Earth's surface.  A return value of NaN indicates an invalid location.
+ *
+ * @param l1 a pointer to a valid location
+ * @param l2 a pointer to a valid location
+ * @return the distance between those points
+ */
+double location_distance(const location *l1, const location *l2);
+
+#endif